@@ -0,0 +1,270 @@
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+// the placement of the threads on the cpus: without an affinity the
+// threads float between the cores (and the sockets) and their slices of
+// the generations follow them from cache to cache; with one, every
+// thread is pinned to its own cpu before it first touches its slice
+// compact fills the cores of a socket one after another (the hardware
+// threads of a core being neighbours), scatter spreads the threads over
+// the sockets and the cores first and uses the hardware threads of a core
+// last, a list gives the cpus of the threads in order; if there are more
+// threads than cpus, the placement starts over
+// the topology is the one from sysfs, restricted to the cpus on which
+// the process may run (taskset, cgroups)
+#define AFFINITY_NONE 0
+#define AFFINITY_COMPACT 1
+#define AFFINITY_SCATTER 2
+#define AFFINITY_LIST 3
+
+#define AFFINITY_MAX_CPUS 1024
+
+// a mask of cpus, as the sched_*affinity system calls see it
+typedef struct _cpu_mask {
+	uint64_t bits[AFFINITY_MAX_CPUS / 64];
+} cpu_mask;
+
+// a cpu, its socket and its core (core_rank numbers the cores of a
+// socket from 0, sibling numbers the hardware threads of a core)
+typedef struct _cpu_info {
+	int cpu;
+	int package;
+	int core;
+	int core_rank;
+	int sibling;
+} cpu_info;
+
+typedef struct _cpu_topology {
+	cpu_info cpus[AFFINITY_MAX_CPUS];
+	int nr_cpus;
+	int nr_cores;
+	int nr_packages;
+} cpu_topology;
+
+// the mask of the calling thread
+int get_thread_affinity(cpu_mask *mask)
+{
+	memset(mask, 0, sizeof(cpu_mask));
+	return syscall(SYS_sched_getaffinity, 0, sizeof(cpu_mask), mask) > 0;
+}
+
+int set_thread_affinity(const cpu_mask *mask)
+{
+	return syscall(SYS_sched_setaffinity, 0, sizeof(cpu_mask), mask) == 0;
+}
+
+// pins the calling thread to a single cpu
+int pin_thread(int cpu)
+{
+	cpu_mask mask;
+
+	memset(&mask, 0, sizeof(cpu_mask));
+	mask.bits[cpu / 64] = 1ULL << (cpu % 64);
+	return set_thread_affinity(&mask);
+}
+
+// a number from the topology of a cpu, or fallback if sysfs has none
+static int read_topology_value(int cpu, const char *name, int fallback)
+{
+	char path[128];
+	FILE *fp;
+	int value;
+
+	snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, name);
+	fp = fopen(path, "r");
+	if (fp == NULL)
+		return fallback;
+	if (fscanf(fp, "%d", &value) != 1)
+		value = fallback;
+	fclose(fp);
+
+	return value;
+}
+
+// numbers the cores of every socket and the hardware threads of every
+// core, in the order of the cpus (there are few cpus and this is done
+// once, so the ranks are counted against the cpus before them)
+void rank_topology(cpu_topology *topology)
+{
+	cpu_info *c, *other;
+
+	topology->nr_cores = 0;
+	topology->nr_packages = 0;
+	for (int i = 0; i < topology->nr_cpus; i++) {
+		c = &topology->cpus[i];
+		c->core_rank = -1;
+		c->sibling = 0;
+		for (int j = 0; j < i; j++) {
+			other = &topology->cpus[j];
+			if (other->package == c->package && other->core == c->core) {
+				c->core_rank = other->core_rank;
+				c->sibling++;
+			}
+		}
+		if (c->core_rank >= 0)
+			continue;
+
+		// the first cpu of a new core (or of a new socket)
+		c->core_rank = 0;
+		for (int j = 0; j < i; j++) {
+			other = &topology->cpus[j];
+			if (other->package == c->package && other->sibling == 0)
+				c->core_rank++;
+		}
+		topology->nr_cores++;
+		if (c->core_rank == 0)
+			topology->nr_packages++;
+	}
+}
+
+// the cpus on which the calling thread may run, in order, with their
+// sockets and cores; returns 0 if the mask cannot be read
+int detect_topology(cpu_topology *topology)
+{
+	cpu_mask allowed;
+	cpu_info *c;
+	int n = 0;
+
+	if (!get_thread_affinity(&allowed))
+		return 0;
+
+	for (int cpu = 0; cpu < AFFINITY_MAX_CPUS; cpu++) {
+		if (!((allowed.bits[cpu / 64] >> (cpu % 64)) & 1))
+			continue;
+		c = &topology->cpus[n++];
+		c->cpu = cpu;
+		c->package = read_topology_value(cpu, "physical_package_id", 0);
+		c->core = read_topology_value(cpu, "core_id", cpu);
+	}
+	topology->nr_cpus = n;
+	rank_topology(topology);
+
+	return 1;
+}
+
+// reads a list of cpus such as 0,2,4-7 in cpus, returns their number
+// or 0 if the list is not valid
+int parse_cpu_list(const char *list, int *cpus, int max)
+{
+	const char *p = list;
+	char *end;
+	int n = 0, first, last;
+
+	while (*p != '\0') {
+		first = (int) strtol(p, &end, 10);
+		if (end == p || first < 0)
+			return 0;
+		last = first;
+		if (*end == '-') {
+			p = end + 1;
+			last = (int) strtol(p, &end, 10);
+			if (end == p || last < first)
+				return 0;
+		}
+		if (last >= AFFINITY_MAX_CPUS)
+			return 0;
+		for (int cpu = first; cpu <= last; cpu++) {
+			if (n == max)
+				return 0;
+			cpus[n++] = cpu;
+		}
+		if (*end == ',' && end[1] != '\0')
+			end++;
+		else if (*end != '\0')
+			return 0;
+		p = end;
+	}
+
+	return n;
+}
+
+static int compare_compact(const void *a, const void *b)
+{
+	const cpu_info *x = a, *y = b;
+
+	if (x->package != y->package)
+		return x->package - y->package;
+	if (x->core_rank != y->core_rank)
+		return x->core_rank - y->core_rank;
+	return x->sibling - y->sibling;
+}
+
+static int compare_scatter(const void *a, const void *b)
+{
+	const cpu_info *x = a, *y = b;
+
+	if (x->sibling != y->sibling)
+		return x->sibling - y->sibling;
+	if (x->core_rank != y->core_rank)
+		return x->core_rank - y->core_rank;
+	return x->package - y->package;
+}
+
+// the cpus of the threads [first_thread, first_thread + nr_threads)
+// in cpus; returns 0 if a cpu of the list is not one of the topology
+int place_threads(const cpu_topology *topology, int policy, const int *list, int list_length,
+	int first_thread, int nr_threads, int *cpus)
+{
+	cpu_info *order;
+	int found;
+
+	if (policy == AFFINITY_LIST) {
+		for (int i = 0; i < list_length; i++) {
+			found = 0;
+			for (int j = 0; j < topology->nr_cpus; j++)
+				found |= topology->cpus[j].cpu == list[i];
+			if (!found)
+				return 0;
+		}
+		for (int i = 0; i < nr_threads; i++)
+			cpus[i] = list[(first_thread + i) % list_length];
+		return 1;
+	}
+
+	order = malloc(topology->nr_cpus * sizeof(cpu_info));
+	if (order == NULL)
+		return 0;
+	memcpy(order, topology->cpus, topology->nr_cpus * sizeof(cpu_info));
+	qsort(order, topology->nr_cpus, sizeof(cpu_info),
+		policy == AFFINITY_SCATTER ? compare_scatter : compare_compact);
+	for (int i = 0; i < nr_threads; i++)
+		cpus[i] = order[(first_thread + i) % topology->nr_cpus].cpu;
+	free(order);
+
+	return 1;
+}
+
+const char *affinity_name(int policy)
+{
+	static const char *names[] = {"none", "compact", "scatter", "list"};
+
+	return names[policy];
+}
+
+// the placement, printed once at startup
+void print_placement(FILE *fp, const cpu_topology *topology, int policy, int first_thread,
+	int nr_threads, const int *cpus)
+{
+	const cpu_info *c;
+
+	fprintf(fp, "afinitate %s: %d cpu-uri, %d nuclee, %d socket-uri\n", affinity_name(policy),
+		topology->nr_cpus, topology->nr_cores, topology->nr_packages);
+	for (int i = 0; i < nr_threads; i++) {
+		c = NULL;
+		for (int j = 0; j < topology->nr_cpus; j++) {
+			if (topology->cpus[j].cpu == cpus[i])
+				c = &topology->cpus[j];
+		}
+		fprintf(fp, "thread %d: cpu %d (socket %d, nucleu %d)\n", first_thread + i, cpus[i],
+			c->package, c->core);
+	}
+}
+
+#endif
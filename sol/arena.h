@@ -0,0 +1,92 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+// size of a huge page, used for rounding the slab when it is
+// backed by transparent huge pages
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+// one slab that holds the chromosomes of all the individuals
+// of a generation buffer, individual i starting at word i * stride
+// the stride is rounded to a cache line, so two individuals never
+// share a line (and the threads never write the same line)
+typedef struct _population_arena {
+	uint64_t *slab;
+	size_t size;
+	int stride;
+	int nr_individuals;
+} population_arena;
+
+// maps the slab without touching it, the pages are placed on
+// the numa node of the thread which first writes them
+// (see first_touch_arena)
+int init_population_arena(population_arena *arena, int nr_individuals,
+	int nr_words, int huge_pages)
+{
+	size_t align = huge_pages ? HUGE_PAGE_SIZE : 4096;
+
+	arena->stride = (nr_words + 7) / 8 * 8;
+	arena->nr_individuals = nr_individuals;
+	arena->size = (size_t) nr_individuals * arena->stride * sizeof(uint64_t);
+	arena->size = (arena->size + align - 1) / align * align;
+
+	arena->slab = mmap(NULL, arena->size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (arena->slab == MAP_FAILED) {
+		arena->slab = NULL;
+		return 0;
+	}
+
+	// the huge pages are only a hint, the slab works without them
+	if (huge_pages) {
+		madvise(arena->slab, arena->size, MADV_HUGEPAGE);
+	}
+
+	return 1;
+}
+
+// the chromosomes of the individual i
+static inline uint64_t *arena_chromosomes(const population_arena *arena, int i)
+{
+	return arena->slab + (size_t) i * arena->stride;
+}
+
+// writes the chromosomes of the individuals from [start, end), so
+// that their pages are allocated by the calling thread
+void first_touch_arena(const population_arena *arena, int start, int end)
+{
+	if (start < end) {
+		memset(arena_chromosomes(arena, start), 0,
+			(size_t) (end - start) * arena->stride * sizeof(uint64_t));
+	}
+}
+
+// maps size bytes of zeros for an array of individuals, page aligned
+// and without touching them, so that its pages too are placed by the
+// threads that first write them; returns NULL on failure
+void *map_individuals(size_t size)
+{
+	void *array = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	return array == MAP_FAILED ? NULL : array;
+}
+
+void unmap_individuals(void *array, size_t size)
+{
+	if (array != NULL)
+		munmap(array, size);
+}
+
+void free_population_arena(population_arena *arena)
+{
+	if (arena->slab != NULL) {
+		munmap(arena->slab, arena->size);
+		arena->slab = NULL;
+	}
+}
+
+#endif
@@ -0,0 +1,248 @@
+#ifndef BARRIER_H
+#define BARRIER_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+// the barriers of the threads of the algorithm, one of:
+// - the barrier of pthreads, which every waiting thread sleeps on in
+//   the kernel
+// - a centralized sense-reversing barrier: the threads count down a
+//   shared counter and spin on a shared sense, which the last one flips
+// - a dissemination barrier: in round r every thread signals the thread
+//   2^r places after it and waits for the one 2^r places before it, so
+//   after log2(P) rounds every thread has heard (indirectly) from all the
+//   others; every thread spins on flags of its own and, after a while,
+//   sleeps on them in the kernel (futex)
+// the spin barrier yields the cpu after a while; with more threads than
+// cpus a thread that spins only keeps the others from arriving, so
+// then both barriers yield or sleep at once
+#define BARRIER_PTHREAD 0
+#define BARRIER_SPIN 1
+#define BARRIER_DISSEMINATION 2
+
+// how many times a thread checks the barrier before it yields
+// the cpu (spin) or sleeps (dissemination)
+#define BARRIER_SPINS 4096
+
+// the flag of a thread for a round of the dissemination barrier: the
+// last episode in which it was signalled and whether the thread sleeps
+// on it (so that the signal also wakes it)
+typedef struct _barrier_flag {
+	_Atomic int episode;
+	_Atomic int sleeping;
+} __attribute__((aligned(64))) barrier_flag;
+
+// the episodes (the barriers passed so far) of a thread, written only by it
+typedef struct _barrier_episode {
+	int episode;
+} __attribute__((aligned(64))) barrier_episode;
+
+typedef struct _thread_barrier {
+	int kind;
+	int nr_threads;
+	int spins;
+	pthread_barrier_t pthread_barrier;
+	// the centralized barrier, on two lines
+	_Atomic int count __attribute__((aligned(64)));
+	_Atomic int sense __attribute__((aligned(64)));
+	// the dissemination barrier, the flags of thread i being
+	// flags[i * nr_rounds, (i + 1) * nr_rounds)
+	int nr_rounds;
+	barrier_flag *flags;
+	barrier_episode *episodes;
+} thread_barrier;
+
+const char *barrier_name(int kind)
+{
+	static const char *names[] = {"pthread", "spin", "dissemination"};
+
+	return names[kind];
+}
+
+// returns 1 on success and 0 on failure
+int init_thread_barrier(thread_barrier *barrier, int nr_threads, int kind)
+{
+	memset(barrier, 0, sizeof(thread_barrier));
+	barrier->kind = kind;
+	barrier->nr_threads = nr_threads;
+
+	if (kind == BARRIER_PTHREAD)
+		return pthread_barrier_init(&barrier->pthread_barrier, NULL, nr_threads) == 0;
+
+	barrier->spins = (nr_threads <= sysconf(_SC_NPROCESSORS_ONLN)) ? BARRIER_SPINS : 0;
+	atomic_init(&barrier->count, nr_threads);
+	atomic_init(&barrier->sense, 0);
+	if (kind == BARRIER_SPIN)
+		return 1;
+
+	while ((1 << barrier->nr_rounds) < nr_threads)
+		barrier->nr_rounds++;
+	barrier->flags = aligned_alloc(64, (nr_threads * barrier->nr_rounds + 1) * sizeof(barrier_flag));
+	barrier->episodes = aligned_alloc(64, nr_threads * sizeof(barrier_episode));
+	if (barrier->flags == NULL || barrier->episodes == NULL) {
+		free(barrier->flags);
+		free(barrier->episodes);
+		return 0;
+	}
+	for (int i = 0; i < nr_threads * barrier->nr_rounds; i++) {
+		atomic_init(&barrier->flags[i].episode, 0);
+		atomic_init(&barrier->flags[i].sleeping, 0);
+	}
+	for (int i = 0; i < nr_threads; i++)
+		barrier->episodes[i].episode = 0;
+
+	return 1;
+}
+
+void destroy_thread_barrier(thread_barrier *barrier)
+{
+	if (barrier->kind == BARRIER_PTHREAD) {
+		pthread_barrier_destroy(&barrier->pthread_barrier);
+	} else {
+		free(barrier->flags);
+		free(barrier->episodes);
+	}
+}
+
+static inline void spin_pause(const thread_barrier *barrier, int spins)
+{
+	if (spins < barrier->spins)
+		__builtin_ia32_pause();
+	else
+		sched_yield();
+}
+
+// the sense the threads wait for is the opposite of the one they find
+// when they arrive, which cannot change before all of them arrive
+static inline void wait_spin_barrier(thread_barrier *barrier)
+{
+	int sense = !atomic_load_explicit(&barrier->sense, memory_order_relaxed);
+
+	if (atomic_fetch_sub_explicit(&barrier->count, 1, memory_order_acq_rel) == 1) {
+		atomic_store_explicit(&barrier->count, barrier->nr_threads, memory_order_relaxed);
+		atomic_store_explicit(&barrier->sense, sense, memory_order_release);
+		return;
+	}
+
+	for (int spins = 0; atomic_load_explicit(&barrier->sense, memory_order_acquire) != sense; spins++)
+		spin_pause(barrier, spins);
+}
+
+// whether a flag was signalled in the episode (or in a later one,
+// the episodes being compared so that they may wrap around)
+static inline int flag_reached(int value, int episode)
+{
+	return (int) ((unsigned) value - (unsigned) episode) >= 0;
+}
+
+static inline void signal_flag(barrier_flag *flag, int episode)
+{
+	atomic_store(&flag->episode, episode);
+	if (atomic_load(&flag->sleeping))
+		syscall(SYS_futex, &flag->episode, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+// spins on the flag, then sleeps on it; the thread says that it sleeps
+// before it checks the flag a last time and the signal is given before
+// the sleeping thread is looked for, so one of the two sees the other
+static inline void wait_flag(const thread_barrier *barrier, barrier_flag *flag, int episode)
+{
+	int value;
+
+	for (int spins = 0; spins < barrier->spins; spins++) {
+		if (flag_reached(atomic_load_explicit(&flag->episode, memory_order_acquire), episode))
+			return;
+		__builtin_ia32_pause();
+	}
+
+	while (1) {
+		atomic_store(&flag->sleeping, 1);
+		value = atomic_load(&flag->episode);
+		if (flag_reached(value, episode))
+			break;
+		syscall(SYS_futex, &flag->episode, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+	}
+	atomic_store_explicit(&flag->sleeping, 0, memory_order_relaxed);
+}
+
+static inline void wait_dissemination_barrier(thread_barrier *barrier, int id)
+{
+	int episode = ++barrier->episodes[id].episode;
+	int P = barrier->nr_threads;
+
+	for (int r = 0, distance = 1; r < barrier->nr_rounds; r++, distance *= 2) {
+		signal_flag(&barrier->flags[(id + distance) % P * barrier->nr_rounds + r], episode);
+		wait_flag(barrier, &barrier->flags[id * barrier->nr_rounds + r], episode);
+	}
+}
+
+// the gate at which the threads of a run wait until all of them are
+// created: if one of them cannot be created, the gate is closed and the
+// others return before they reach a barrier that would wait for it
+#define GATE_WAITING 0
+#define GATE_OPEN 1
+#define GATE_CLOSED 2
+
+typedef struct _start_gate {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int state;
+} start_gate;
+
+void init_start_gate(start_gate *gate)
+{
+	pthread_mutex_init(&gate->lock, NULL);
+	pthread_cond_init(&gate->cond, NULL);
+	gate->state = GATE_WAITING;
+}
+
+void destroy_start_gate(start_gate *gate)
+{
+	pthread_mutex_destroy(&gate->lock);
+	pthread_cond_destroy(&gate->cond);
+}
+
+// opens (GATE_OPEN) or closes (GATE_CLOSED) the gate for all the threads
+void release_start_gate(start_gate *gate, int state)
+{
+	pthread_mutex_lock(&gate->lock);
+	gate->state = state;
+	pthread_cond_broadcast(&gate->cond);
+	pthread_mutex_unlock(&gate->lock);
+}
+
+// returns 1 if the gate was opened and 0 if it was closed
+int pass_start_gate(start_gate *gate)
+{
+	int state;
+
+	pthread_mutex_lock(&gate->lock);
+	while (gate->state == GATE_WAITING)
+		pthread_cond_wait(&gate->cond, &gate->lock);
+	state = gate->state;
+	pthread_mutex_unlock(&gate->lock);
+
+	return state == GATE_OPEN;
+}
+
+// id is the number of the thread among the nr_threads of the barrier
+static inline void barrier_wait(thread_barrier *barrier, int id)
+{
+	if (barrier->kind == BARRIER_SPIN)
+		wait_spin_barrier(barrier);
+	else if (barrier->kind == BARRIER_DISSEMINATION)
+		wait_dissemination_barrier(barrier, id);
+	else
+		pthread_barrier_wait(&barrier->pthread_barrier);
+}
+
+#endif
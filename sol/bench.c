@@ -0,0 +1,381 @@
+#include <unistd.h>
+#include <x86intrin.h>
+#include "helpers.h"
+
+// micro-benchmarks of the kernels of the algorithm, on random
+// populations of the given instances; every line of the output is
+//   kernel,variant,input,threads,individuals,genes,reps,ns_per_individual,gb_per_s,cycles_per_gene
+// (the cycles are the ones of the time stamp counter, the bytes are the
+// chromosome words and individuals read and written by the kernel and
+// the genes are the genes of the whole population)
+
+#define BENCH_MIN_REPS 3
+#define BENCH_MAX_REPS 10000
+// the number of genes processed by every measurement
+#define BENCH_GENES 50000000.0
+
+// the kernels that can be measured
+#define BENCH_FITNESS 0
+#define BENCH_EVALUATE 1
+#define BENCH_SORT 2
+#define BENCH_MUTATE_1 3
+#define BENCH_MUTATE_2 4
+#define BENCH_CROSSOVER 5
+#define BENCH_COPY 6
+#define BENCH_BARRIER 7
+
+// the data shared by the threads of a measurement
+typedef struct _bench_state {
+	object_table *table;
+	individual *population;
+	individual *children;
+	individual *prev;
+	individual *backup;
+	selection_state selection;
+	work_pool pool;
+	thread_barrier barrier;
+	int capacity;
+	int length;
+	int nr_threads;
+	int reps;
+	int kernel;
+	int sort_mode;
+	int barrier_kind;
+	uint64_t ns;
+	uint64_t cycles;
+} bench_state;
+
+typedef struct _bench_args {
+	bench_state *state;
+	int id;
+} bench_args;
+
+// deterministic random numbers (xorshift), so that all the variants
+// see the same populations
+static inline uint64_t next_random(uint64_t *seed)
+{
+	*seed ^= *seed << 13;
+	*seed ^= *seed >> 7;
+	*seed ^= *seed << 17;
+	return *seed;
+}
+
+// runs the measured kernel on the slice of the thread, the time is
+// taken by thread 0 between two barriers
+void *bench_thread(void *arg)
+{
+	bench_args *args = arg;
+	bench_state *state = args->state;
+	int id = args->id, P = state->nr_threads, length = state->length;
+	int start = id * (double) length / P;
+	int end = (id + 1) * (double) length / P;
+	int pair_start = id * (double) (length / 2) / P;
+	int pair_end = (id + 1) * (double) (length / 2) / P;
+	individual *v = state->population, *v_prev = state->prev;
+	uint64_t ns = 0, cycles = 0, t0 = 0, c0 = 0;
+	info info_ms;
+
+	info_ms.id = id;
+	info_ms.count = length;
+	info_ms.barrier = &state->barrier;
+	info_ms.v = &v;
+	info_ms.v_prev = &v_prev;
+	info_ms.actual_length = length;
+	info_ms.nr_threads = P;
+	info_ms.sort_mode = state->sort_mode;
+	info_ms.top = length / 2;
+	info_ms.selection = &state->selection;
+	info_ms.pool = &state->pool;
+
+	for (int r = 0; r < state->reps; r++) {
+		// the sorts start every time from the same order
+		if (state->kernel == BENCH_SORT) {
+			for (int i = start; i < end; i++)
+				v[i] = state->backup[i];
+		}
+		barrier_wait(&state->barrier, id);
+		if (id == 0) {
+			t0 = monotonic_ns();
+			c0 = __rdtsc();
+		}
+
+		switch (state->kernel) {
+		case BENCH_FITNESS:
+			compute_fitness_function_parallel(v, length, state->capacity, id, P, 1);
+			break;
+		case BENCH_EVALUATE:
+			for (int i = start; i < end; i++)
+				evaluate_individual(v + i, state->table);
+			break;
+		case BENCH_SORT:
+			sort_generation_parallel(&info_ms);
+			break;
+		case BENCH_MUTATE_1:
+			for (int i = start; i < end; i++)
+				mutate_bit_string_1(v + i, r, state->table);
+			break;
+		case BENCH_MUTATE_2:
+			for (int i = start; i < end; i++)
+				mutate_bit_string_2(v + i, r, state->table);
+			break;
+		case BENCH_CROSSOVER:
+			for (int i = pair_start; i < pair_end; i++)
+				crossover(v + 2 * i, state->children + 2 * i, r, state->table);
+			break;
+		case BENCH_COPY:
+			for (int i = start; i < end; i++)
+				copy_individual(v + i, state->children + i);
+			break;
+		case BENCH_BARRIER:
+			// one wait for every individual
+			for (int i = 0; i < length; i++)
+				barrier_wait(&state->barrier, id);
+			break;
+		}
+
+		barrier_wait(&state->barrier, id);
+		if (id == 0) {
+			cycles += __rdtsc() - c0;
+			ns += monotonic_ns() - t0;
+		}
+	}
+
+	if (id == 0) {
+		state->ns = ns;
+		state->cycles = cycles;
+	}
+
+	return NULL;
+}
+
+// bytes read and written by the kernel for every individual
+double bench_bytes(int kernel, int nr_words)
+{
+	switch (kernel) {
+	case BENCH_FITNESS:
+		return sizeof(individual);
+	case BENCH_EVALUATE:
+		return nr_words * sizeof(uint64_t);
+	case BENCH_SORT:
+		return 2 * sizeof(individual);
+	case BENCH_BARRIER:
+		return 0;
+	default:
+		// the chromosomes are read and written
+		return 2 * nr_words * sizeof(uint64_t);
+	}
+}
+
+// measures a kernel with P threads and prints its line
+int run_bench(bench_state *state, const char *name, const char *variant,
+	const char *input, int nr_threads)
+{
+	pthread_t threads[nr_threads];
+	bench_args args[nr_threads];
+	double individuals, genes;
+	int nr_words = chromosome_words(state->table->nr_objects);
+
+	state->nr_threads = nr_threads;
+	if (!init_thread_barrier(&state->barrier, nr_threads, state->barrier_kind))
+		return 0;
+	if (!init_work_pool(&state->pool, nr_threads)
+		|| !init_selection_state(&state->selection, state->length, nr_threads)) {
+		printf("Eroare la alocarea memoriei pentru benchmark\n");
+		exit(-1);
+	}
+
+	for (int i = 0; i < nr_threads; i++) {
+		args[i].state = state;
+		args[i].id = i;
+		if (pthread_create(&threads[i], NULL, bench_thread, &args[i])) {
+			printf("Error when creating the thread\n");
+			exit(-1);
+		}
+	}
+	for (int i = 0; i < nr_threads; i++)
+		pthread_join(threads[i], NULL);
+
+	destroy_thread_barrier(&state->barrier);
+	free_selection_state(&state->selection);
+	free_work_pool(&state->pool);
+
+	individuals = (double) state->length * state->reps;
+	genes = individuals * state->table->nr_objects;
+	printf("%s,%s,%s,%d,%d,%d,%d,%.3f,%.3f,%.4f\n", name, variant, input, nr_threads,
+		state->length, state->table->nr_objects, state->reps,
+		state->ns / individuals,
+		individuals * bench_bytes(state->kernel, nr_words) / state->ns,
+		state->cycles / genes);
+	fflush(stdout);
+
+	return 1;
+}
+
+// builds a random population (about one object in eight in the sack)
+// of length individuals, each with its own chromosomes
+void random_population(individual *population, population_arena *arena, int length,
+	const object_table *table, uint64_t *seed)
+{
+	int nr_words = chromosome_words(table->nr_objects);
+	uint64_t *chromosomes;
+
+	for (int i = 0; i < length; i++) {
+		chromosomes = arena_chromosomes(arena, i);
+		for (int w = 0; w < nr_words; w++)
+			chromosomes[w] = next_random(seed) & next_random(seed) & next_random(seed);
+		if (table->nr_objects & 63)
+			chromosomes[nr_words - 1] &= (1ULL << (table->nr_objects & 63)) - 1;
+
+		memset(population + i, 0, sizeof(individual));
+		population[i].chromosomes = chromosomes;
+		population[i].chromosome_length = table->nr_objects;
+		population[i].index = i;
+		population[i].handle = i;
+		evaluate_individual(population + i, table);
+	}
+}
+
+// runs all the kernels on one instance
+void bench_input(const char *path, const int *thread_counts, int nr_counts, int population_size)
+{
+	static const char *sort_names[] = {"merge", "topk", "radix"};
+	object_table table;
+	population_arena arenas[2];
+	bench_state state;
+	uint64_t seed = 88172645463325252ULL;
+	const char *input = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+	int length, nr_words, P;
+
+	memset(&state, 0, sizeof(bench_state));
+	if (!load_instance(path, &table, &state.capacity, 1)) {
+		fprintf(stderr, "Eroare la citirea fisierului %s\n", path);
+		return;
+	}
+
+	length = population_size ? population_size : table.nr_objects;
+	length -= length % 2;
+	if (length < 2)
+		length = 2;
+	nr_words = chromosome_words(table.nr_objects);
+
+	state.table = &table;
+	state.length = length;
+	state.reps = BENCH_GENES / ((double) length * table.nr_objects);
+	if (state.reps < BENCH_MIN_REPS)
+		state.reps = BENCH_MIN_REPS;
+	if (state.reps > BENCH_MAX_REPS)
+		state.reps = BENCH_MAX_REPS;
+
+	state.population = calloc(length, sizeof(individual));
+	state.children = calloc(length, sizeof(individual));
+	state.prev = calloc(length, sizeof(individual));
+	state.backup = calloc(length, sizeof(individual));
+	if (!state.population || !state.children || !state.prev || !state.backup
+		|| !init_population_arena(&arenas[0], length, nr_words, 0)
+		|| !init_population_arena(&arenas[1], length, nr_words, 0)) {
+		printf("Eroare la alocarea memoriei pentru benchmark\n");
+		exit(-1);
+	}
+
+	random_population(state.population, &arenas[0], length, &table, &seed);
+	random_population(state.children, &arenas[1], length, &table, &seed);
+	for (int i = 0; i < length; i++) {
+		state.population[i].fitness = (state.population[i].weight <= state.capacity)
+			? state.population[i].profit : 0;
+	}
+	memcpy(state.backup, state.population, length * sizeof(individual));
+
+	for (int c = 0; c < nr_counts; c++) {
+		P = thread_counts[c];
+
+		state.kernel = BENCH_FITNESS;
+		run_bench(&state, "fitness", "default", input, P);
+
+		// the kernels that have a variant for every instruction set,
+		// in each variant supported by the cpu
+		for (int isa = ISA_SCALAR; isa < NR_ISAS; isa++) {
+			if (!isa_supported(isa))
+				continue;
+			select_kernels(isa);
+			state.kernel = BENCH_EVALUATE;
+			run_bench(&state, "evaluate", isa_name(isa), input, P);
+			state.kernel = BENCH_MUTATE_2;
+			run_bench(&state, "mutate_bit_string_2", isa_name(isa), input, P);
+			state.kernel = BENCH_CROSSOVER;
+			run_bench(&state, "crossover", isa_name(isa), input, P);
+			state.kernel = BENCH_COPY;
+			run_bench(&state, "copy_individual", isa_name(isa), input, P);
+		}
+		select_kernels(ISA_AUTO);
+
+		state.kernel = BENCH_SORT;
+		for (int s = SORT_MERGE; s <= SORT_RADIX; s++) {
+			state.sort_mode = s;
+			run_bench(&state, "sort", sort_names[s], input, P);
+		}
+
+		state.kernel = BENCH_MUTATE_1;
+		run_bench(&state, "mutate_bit_string_1", "default", input, P);
+
+		// the barriers, which all the other kernels use in
+		// their default variant
+		state.kernel = BENCH_BARRIER;
+		for (int b = BARRIER_PTHREAD; b <= BARRIER_DISSEMINATION; b++) {
+			state.barrier_kind = b;
+			run_bench(&state, "barrier", barrier_name(b), input, P);
+		}
+		state.barrier_kind = BARRIER_PTHREAD;
+	}
+
+	free_population_arena(&arenas[0]);
+	free_population_arena(&arenas[1]);
+	free(state.population);
+	free(state.children);
+	free(state.prev);
+	free(state.backup);
+	free_object_table(&table);
+}
+
+// usage: ./bench [--threads=1,2,4] [--population=M] input...
+int main(int argc, char* argv[]) {
+
+	int thread_counts[64];
+	int nr_counts = 0;
+	int population_size = 0;
+	char *p, *end;
+
+	select_kernels(ISA_AUTO);
+
+	for (int i = 1; i < argc; i++) {
+		if (!strncmp(argv[i], "--threads=", 10)) {
+			for (p = argv[i] + 10; *p != '\0' && nr_counts < 64; p = (*end == ',') ? end + 1 : end) {
+				thread_counts[nr_counts] = (int) strtol(p, &end, 10);
+				if (end == p || thread_counts[nr_counts] <= 0) {
+					fprintf(stderr, "Numar invalid de thread-uri: %s\n", argv[i] + 10);
+					return 1;
+				}
+				nr_counts++;
+			}
+		} else if (!strncmp(argv[i], "--population=", 13)) {
+			population_size = (int) strtol(argv[i] + 13, &end, 10);
+			if (*end != '\0' || population_size <= 0) {
+				fprintf(stderr, "Dimensiune invalida a populatiei: %s\n", argv[i] + 13);
+				return 1;
+			}
+		}
+	}
+
+	// by default 1, 2, 4, ... threads, up to the number of cpus
+	if (nr_counts == 0) {
+		for (int P = 1; P <= sysconf(_SC_NPROCESSORS_ONLN) && nr_counts < 64; P *= 2)
+			thread_counts[nr_counts++] = P;
+	}
+
+	printf("kernel,variant,input,threads,individuals,genes,reps,ns_per_individual,gb_per_s,cycles_per_gene\n");
+	for (int i = 1; i < argc; i++) {
+		if (strncmp(argv[i], "--", 2))
+			bench_input(argv[i], thread_counts, nr_counts, population_size);
+	}
+
+	return 0;
+}
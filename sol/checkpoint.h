@@ -0,0 +1,346 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "fitness.h"
+#include "individual.h"
+#include "stop_policy.h"
+
+// a checkpoint holds everything a generation reads when it starts: for
+// every slot the totals, the fitness and the index of the individual of
+// the current generation and the fitness and the index of the slot of
+// the next generation (the skel reads both, see mutate_bit_string_1 and
+// the print after the swap), the chromosomes of the current generation,
+// the best fitness of every island, the state of the stop policy and
+// the object table
+// the file is laid out like the buffer it is written from, every
+// section being 64 byte aligned, so it can be mapped and read in place
+#define CHECKPOINT_MAGIC "GACKPT01"
+#define CHECKPOINT_HEADER_SIZE 128
+
+typedef struct _checkpoint_header {
+	char magic[8];
+	int32_t nr_objects;
+	int32_t capacity;
+	int32_t nr_padded;
+	int32_t nr_words;
+	int32_t population_size;
+	int32_t nr_islands;
+	// the first generation that is not done yet
+	int32_t generation;
+	int32_t reserved0;
+	int64_t islands_offset;
+	int64_t table_offset;
+	int64_t records_offset;
+	int64_t chromosomes_offset;
+	int64_t size;
+	// the state of the stop policy, if the run had one: the best
+	// fitness so far, the generation in which it was reached and the
+	// time the run took up to the checkpoint
+	int32_t has_stop_state;
+	int32_t stop_best_fitness;
+	int32_t stop_last_improvement;
+	int32_t reserved1;
+	int64_t stop_elapsed_ns;
+	char reserved[CHECKPOINT_HEADER_SIZE - 104];
+} checkpoint_header;
+
+typedef struct _checkpoint_record {
+	int fitness;
+	int index;
+	int count;
+	int weight;
+	int profit;
+	int next_fitness;
+	int next_index;
+	int reserved;
+} checkpoint_record;
+
+// the snapshot is copied by the threads in a buffer, then written by a
+// thread of its own while the generations go on; a checkpoint is skipped
+// if the previous one is still being written
+typedef struct _checkpoint_writer {
+	const char *path;
+	char *buffer;
+	size_t size;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int pending;
+	int stop;
+	_Atomic int busy;
+	// whether the threads copy the current generation, decided by
+	// one thread between two barriers
+	int take;
+} checkpoint_writer;
+
+static inline size_t align_section(size_t offset)
+{
+	return (offset + 63) / 64 * 64;
+}
+
+// the offsets of the sections of a checkpoint
+void init_checkpoint_header(checkpoint_header *header, const object_table *table, int capacity,
+	int population_size, int nr_islands)
+{
+	memset(header, 0, sizeof(checkpoint_header));
+	memcpy(header->magic, CHECKPOINT_MAGIC, 8);
+	header->nr_objects = table->nr_objects;
+	header->capacity = capacity;
+	header->nr_padded = table->nr_padded;
+	header->nr_words = table->nr_padded / 64;
+	header->population_size = population_size;
+	header->nr_islands = nr_islands;
+
+	header->islands_offset = CHECKPOINT_HEADER_SIZE;
+	header->table_offset = align_section(header->islands_offset + nr_islands * sizeof(int));
+	header->records_offset = align_section(header->table_offset + 2 * (size_t) table->nr_padded * sizeof(int));
+	header->chromosomes_offset = align_section(header->records_offset
+		+ (size_t) population_size * sizeof(checkpoint_record));
+	header->size = header->chromosomes_offset + (size_t) population_size * header->nr_words * sizeof(uint64_t);
+}
+
+static inline int *checkpoint_islands(char *base)
+{
+	return (int *) (base + ((checkpoint_header *) base)->islands_offset);
+}
+
+static inline checkpoint_record *checkpoint_records(char *base)
+{
+	return (checkpoint_record *) (base + ((checkpoint_header *) base)->records_offset);
+}
+
+static inline uint64_t *checkpoint_chromosomes(char *base, int i)
+{
+	checkpoint_header *header = (checkpoint_header *) base;
+
+	return (uint64_t *) (base + header->chromosomes_offset) + (size_t) i * header->nr_words;
+}
+
+// copies the slots [start, end) of an island whose first slot is
+// first in the population
+void save_checkpoint_slice(char *base, const individual *current_generation,
+	const individual *next_generation, int first, int start, int end)
+{
+	checkpoint_record *records = checkpoint_records(base);
+	int nr_words = ((checkpoint_header *) base)->nr_words;
+	checkpoint_record *record;
+
+	for (int i = start; i < end; i++) {
+		record = &records[first + i];
+		record->fitness = current_generation[i].fitness;
+		record->index = current_generation[i].index;
+		record->count = current_generation[i].count;
+		record->weight = current_generation[i].weight;
+		record->profit = current_generation[i].profit;
+		record->next_fitness = next_generation[i].fitness;
+		record->next_index = next_generation[i].index;
+		memcpy(checkpoint_chromosomes(base, first + i), current_generation[i].chromosomes,
+			nr_words * sizeof(uint64_t));
+	}
+}
+
+// the reverse of save_checkpoint_slice, the individuals of the current
+// generation already having their buffers
+void restore_checkpoint_slice(char *base, individual *current_generation,
+	individual *next_generation, int first, int start, int end)
+{
+	checkpoint_record *records = checkpoint_records(base);
+	int nr_words = ((checkpoint_header *) base)->nr_words;
+	checkpoint_record *record;
+
+	for (int i = start; i < end; i++) {
+		record = &records[first + i];
+		current_generation[i].fitness = record->fitness;
+		current_generation[i].index = record->index;
+		current_generation[i].count = record->count;
+		current_generation[i].weight = record->weight;
+		current_generation[i].profit = record->profit;
+		next_generation[i].fitness = record->next_fitness;
+		next_generation[i].index = record->next_index;
+		memcpy(current_generation[i].chromosomes, checkpoint_chromosomes(base, first + i),
+			nr_words * sizeof(uint64_t));
+	}
+}
+
+// writes the file next to its final name, then renames it, so that
+// a checkpoint is never seen half written
+int write_checkpoint_file(const char *path, const char *buffer, size_t size)
+{
+	char tmp_path[4096];
+	ssize_t written;
+	size_t done = 0;
+	int fd;
+
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+	fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return 0;
+
+	while (done < size) {
+		written = write(fd, buffer + done, size - done);
+		if (written <= 0) {
+			close(fd);
+			return 0;
+		}
+		done += written;
+	}
+
+	if (fsync(fd) < 0 || close(fd) < 0)
+		return 0;
+
+	return rename(tmp_path, path) == 0;
+}
+
+void *checkpoint_writer_thread(void *arg)
+{
+	checkpoint_writer *writer = arg;
+
+	pthread_mutex_lock(&writer->lock);
+	while (1) {
+		while (!writer->pending && !writer->stop)
+			pthread_cond_wait(&writer->cond, &writer->lock);
+		if (!writer->pending)
+			break;
+		writer->pending = 0;
+		pthread_mutex_unlock(&writer->lock);
+
+		if (!write_checkpoint_file(writer->path, writer->buffer, writer->size))
+			fprintf(stderr, "Eroare la scrierea checkpoint-ului %s\n", writer->path);
+		atomic_store(&writer->busy, 0);
+
+		pthread_mutex_lock(&writer->lock);
+	}
+	pthread_mutex_unlock(&writer->lock);
+
+	return NULL;
+}
+
+// allocates the buffer of the snapshots, with the header and the
+// object table, which do not change, and starts the writer
+int start_checkpoint_writer(checkpoint_writer *writer, const char *path, const object_table *table,
+	int capacity, int population_size, int nr_islands)
+{
+	checkpoint_header header;
+
+	init_checkpoint_header(&header, table, capacity, population_size, nr_islands);
+	memset(writer, 0, sizeof(checkpoint_writer));
+	writer->path = path;
+	writer->size = header.size;
+	writer->buffer = aligned_alloc(64, align_section(header.size));
+	if (writer->buffer == NULL)
+		return 0;
+
+	memset(writer->buffer, 0, header.size);
+	memcpy(writer->buffer, &header, sizeof(checkpoint_header));
+	memcpy(writer->buffer + header.table_offset, table->weights, table->nr_padded * sizeof(int));
+	memcpy(writer->buffer + header.table_offset + table->nr_padded * sizeof(int), table->profits,
+		table->nr_padded * sizeof(int));
+
+	pthread_mutex_init(&writer->lock, NULL);
+	pthread_cond_init(&writer->cond, NULL);
+	atomic_init(&writer->busy, 0);
+	if (pthread_create(&writer->thread, NULL, checkpoint_writer_thread, writer)) {
+		free(writer->buffer);
+		return 0;
+	}
+
+	return 1;
+}
+
+// called once the threads copied the generation in the buffer, with
+// the state of the stop policy (NULL if there is none)
+void request_checkpoint(checkpoint_writer *writer, int generation, const stop_state *stop)
+{
+	checkpoint_header *header = (checkpoint_header *) writer->buffer;
+
+	header->generation = generation;
+	header->has_stop_state = stop != NULL;
+	if (stop != NULL) {
+		header->stop_best_fitness = stop->best_fitness;
+		header->stop_last_improvement = stop->last_improvement;
+		header->stop_elapsed_ns = monotonic_ns() - stop->start_ns;
+	}
+	atomic_store(&writer->busy, 1);
+
+	pthread_mutex_lock(&writer->lock);
+	writer->pending = 1;
+	pthread_cond_signal(&writer->cond);
+	pthread_mutex_unlock(&writer->lock);
+}
+
+// waits for the last checkpoint to be written
+void stop_checkpoint_writer(checkpoint_writer *writer)
+{
+	pthread_mutex_lock(&writer->lock);
+	writer->stop = 1;
+	pthread_cond_signal(&writer->cond);
+	pthread_mutex_unlock(&writer->lock);
+
+	pthread_join(writer->thread, NULL);
+	pthread_mutex_destroy(&writer->lock);
+	pthread_cond_destroy(&writer->cond);
+	free(writer->buffer);
+}
+
+// a resumed run goes on with the state of the stop policy of the
+// checkpoint, if it has one, or starts the policy at its generation
+void restore_checkpoint_stop(const char *base, stop_state *state)
+{
+	const checkpoint_header *header = (const checkpoint_header *) base;
+
+	if (header->has_stop_state)
+		resume_stop_state(state, header->stop_best_fitness, header->stop_last_improvement,
+			header->stop_elapsed_ns);
+}
+
+// maps a checkpoint and checks that it belongs to the same instance
+// and to the same population; returns the mapping or NULL
+char *map_checkpoint(const char *path, const object_table *table, int capacity,
+	int population_size, int nr_islands, size_t *size)
+{
+	checkpoint_header expected, *header;
+	struct stat st;
+	char *base;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+	if (fstat(fd, &st) < 0 || st.st_size < CHECKPOINT_HEADER_SIZE) {
+		close(fd);
+		return NULL;
+	}
+
+	base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED)
+		return NULL;
+
+	init_checkpoint_header(&expected, table, capacity, population_size, nr_islands);
+	header = (checkpoint_header *) base;
+	if (memcmp(header->magic, CHECKPOINT_MAGIC, 8) || header->size != st.st_size
+		|| header->size != expected.size || header->nr_objects != expected.nr_objects
+		|| header->capacity != capacity || header->population_size != population_size
+		|| header->nr_islands != nr_islands
+		|| memcmp(base + header->table_offset, table->weights, table->nr_objects * sizeof(int))
+		|| memcmp(base + header->table_offset + table->nr_padded * sizeof(int), table->profits,
+			table->nr_objects * sizeof(int))) {
+		munmap(base, st.st_size);
+		return NULL;
+	}
+
+	*size = st.st_size;
+	return base;
+}
+
+#endif
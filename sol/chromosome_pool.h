@@ -0,0 +1,119 @@
+#ifndef CHROMOSOME_POOL_H
+#define CHROMOSOME_POOL_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "arena.h"
+#include "individual.h"
+
+// the chromosome buffers of the two arenas (2 * N buffers, handle h
+// being buffer h % N of arena h / N) shared by the individuals
+// with reference counts: an elite child points to the buffer of its
+// parent and a child that is about to be mutated gets its own copy
+// only when it writes (copy on write)
+// the free buffers are kept on a stack; buffers are only released
+// after all the children of a generation are created and only taken
+// while they are created, with barriers in between, so an atomic
+// top of the stack is enough
+typedef struct _chromosome_pool {
+	population_arena *arenas;
+	int nr_individuals;
+	int nr_words;
+	_Atomic int *refs;
+	int *free_handles;
+	_Atomic int free_top;
+} chromosome_pool;
+
+// the first nr_individuals handles belong to the first generation,
+// the others are free
+int init_chromosome_pool(chromosome_pool *pool, population_arena *arenas,
+	int nr_individuals, int nr_words)
+{
+	pool->arenas = arenas;
+	pool->nr_individuals = nr_individuals;
+	pool->nr_words = nr_words;
+	pool->refs = malloc(2 * nr_individuals * sizeof(_Atomic int));
+	pool->free_handles = malloc(2 * nr_individuals * sizeof(int));
+	if (pool->refs == NULL || pool->free_handles == NULL) {
+		free(pool->refs);
+		free(pool->free_handles);
+		return 0;
+	}
+
+	for (int h = 0; h < 2 * nr_individuals; h++) {
+		atomic_init(&pool->refs[h], h < nr_individuals);
+	}
+	for (int h = 0; h < nr_individuals; h++) {
+		pool->free_handles[h] = 2 * nr_individuals - 1 - h;
+	}
+	atomic_init(&pool->free_top, nr_individuals);
+
+	return 1;
+}
+
+void free_chromosome_pool(chromosome_pool *pool)
+{
+	free(pool->refs);
+	free(pool->free_handles);
+	pool->refs = NULL;
+	pool->free_handles = NULL;
+}
+
+static inline uint64_t *pool_buffer(const chromosome_pool *pool, int handle)
+{
+	return arena_chromosomes(&pool->arenas[handle / pool->nr_individuals],
+		handle % pool->nr_individuals);
+}
+
+// gives the individual a buffer of its own, with unspecified contents
+void acquire_chromosomes(chromosome_pool *pool, individual *ind)
+{
+	int top = atomic_fetch_sub(&pool->free_top, 1) - 1;
+
+	ind->handle = pool->free_handles[top];
+	ind->chromosomes = pool_buffer(pool, ind->handle);
+	atomic_store(&pool->refs[ind->handle], 1);
+}
+
+// drops the reference of the individual to its buffer, the buffer
+// is free when no individual points to it anymore
+void release_chromosomes(chromosome_pool *pool, individual *ind)
+{
+	if (atomic_fetch_sub(&pool->refs[ind->handle], 1) == 1) {
+		pool->free_handles[atomic_fetch_add(&pool->free_top, 1)] = ind->handle;
+	}
+	ind->handle = -1;
+	ind->chromosomes = NULL;
+}
+
+// to points to the chromosomes of from, with the same totals
+void share_chromosomes(chromosome_pool *pool, const individual *from, individual *to)
+{
+	atomic_fetch_add(&pool->refs[from->handle], 1);
+	to->handle = from->handle;
+	to->chromosomes = from->chromosomes;
+	to->weight = from->weight;
+	to->profit = from->profit;
+	to->count = from->count;
+}
+
+// called before the chromosomes of an individual are changed: if the
+// buffer is shared, the individual gets a copy of its own
+// (the other owner is the parent, which keeps its reference until
+// the generation is done, so the count never drops to 0 here)
+void make_writable(chromosome_pool *pool, individual *ind)
+{
+	int shared = ind->handle;
+
+	if (atomic_load(&pool->refs[shared]) == 1)
+		return;
+
+	acquire_chromosomes(pool, ind);
+	memcpy(ind->chromosomes, pool_buffer(pool, shared), pool->nr_words * sizeof(uint64_t));
+	atomic_fetch_sub(&pool->refs[shared], 1);
+}
+
+#endif
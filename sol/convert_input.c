@@ -0,0 +1,36 @@
+#include <stdio.h>
+#include <unistd.h>
+#include "input.h"
+
+// converts a text instance into a binary one, which is then
+// loaded by tema1_par without any parsing
+int main(int argc, char* argv[]) {
+
+	object_table table;
+	int capacity = 0;
+	int nr_threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (argc < 3) {
+		fprintf(stderr, "Usage:\n\t./convert_input in_file out_file\n");
+		return 1;
+	}
+
+	if (nr_threads <= 0) {
+		nr_threads = 1;
+	}
+
+	if (!load_instance(argv[1], &table, &capacity, nr_threads)) {
+		fprintf(stderr, "Eroare la citirea fisierului %s\n", argv[1]);
+		return 1;
+	}
+
+	if (!save_binary_instance(argv[2], &table, capacity)) {
+		fprintf(stderr, "Eroare la scrierea fisierului %s\n", argv[2]);
+		free_object_table(&table);
+		return 1;
+	}
+
+	free_object_table(&table);
+
+	return 0;
+}
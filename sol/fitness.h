@@ -0,0 +1,274 @@
+#ifndef FITNESS_H
+#define FITNESS_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <immintrin.h>
+#include <sys/mman.h>
+#include "sack_object.h"
+#include "isa.h"
+
+// the objects stored as a structure of arrays, so that the
+// weights and the profits of 8 or 16 consecutive genes can be
+// loaded with a single vector instruction
+// both arrays are 64 byte aligned and padded with zeros up to
+// a multiple of 64 objects (one chromosome word)
+// the prefix arrays hold the sums of the first i objects, so that
+// the total of any range of objects is known in O(1)
+// when the table is loaded from a binary instance the two arrays
+// point directly into the mapping of the file
+typedef struct _object_table {
+	int *weights;
+	int *profits;
+	int *weight_prefix;
+	int *profit_prefix;
+	int nr_objects;
+	int nr_padded;
+	void *mapping;
+	size_t mapping_size;
+} object_table;
+
+// the sums computed by a fitness kernel over a part of a chromosome
+typedef struct _fitness_sums {
+	int weight;
+	int profit;
+	int count;
+} fitness_sums;
+
+// a fitness kernel sums the weight, the profit and the number of
+// the objects selected by nr_words chromosome words, starting
+// with the object of index first_word * 64
+typedef fitness_sums (*fitness_kernel_fn)(const uint64_t *chromosomes, int first_word,
+	int nr_words, const object_table *table);
+
+void free_object_table(object_table *table)
+{
+	if (table->mapping != NULL) {
+		munmap(table->mapping, table->mapping_size);
+	} else {
+		free(table->weights);
+		free(table->profits);
+	}
+	free(table->weight_prefix);
+	free(table->profit_prefix);
+	table->mapping = NULL;
+	table->weights = NULL;
+	table->profits = NULL;
+	table->weight_prefix = NULL;
+	table->profit_prefix = NULL;
+}
+
+// number of objects rounded up to a whole chromosome word
+static inline int padded_objects(int nr_objects)
+{
+	return (nr_objects + 63) / 64 * 64;
+}
+
+// allocates the (zeroed) arrays of weights and profits of a table
+int alloc_object_table(object_table *table, int nr_objects)
+{
+	memset(table, 0, sizeof(object_table));
+	table->nr_objects = nr_objects;
+	table->nr_padded = padded_objects(nr_objects);
+	table->weights = aligned_alloc(64, table->nr_padded * sizeof(int));
+	table->profits = aligned_alloc(64, table->nr_padded * sizeof(int));
+	if (table->weights == NULL || table->profits == NULL) {
+		free_object_table(table);
+		return 0;
+	}
+
+	memset(table->weights, 0, table->nr_padded * sizeof(int));
+	memset(table->profits, 0, table->nr_padded * sizeof(int));
+
+	return 1;
+}
+
+// computes the prefix sums, once the weights and the profits are known
+int finish_object_table(object_table *table)
+{
+	int nr_objects = table->nr_objects;
+
+	table->weight_prefix = malloc((nr_objects + 1) * sizeof(int));
+	table->profit_prefix = malloc((nr_objects + 1) * sizeof(int));
+	if (table->weight_prefix == NULL || table->profit_prefix == NULL) {
+		free_object_table(table);
+		return 0;
+	}
+
+	table->weight_prefix[0] = 0;
+	table->profit_prefix[0] = 0;
+	for (int i = 0; i < nr_objects; i++) {
+		table->weight_prefix[i + 1] = table->weight_prefix[i] + table->weights[i];
+		table->profit_prefix[i + 1] = table->profit_prefix[i] + table->profits[i];
+	}
+
+	return 1;
+}
+
+// builds the object table from an array of objects
+int init_object_table(object_table *table, const sack_object *objects, int nr_objects)
+{
+	if (!alloc_object_table(table, nr_objects)) {
+		return 0;
+	}
+
+	for (int i = 0; i < nr_objects; i++) {
+		table->weights[i] = objects[i].weight;
+		table->profits[i] = objects[i].profit;
+	}
+
+	return finish_object_table(table);
+}
+
+// adds to sums the objects selected by a single word,
+// the one with the index j in the chromosome
+static inline void add_word_sums(fitness_sums *sums, uint64_t word, int j,
+	const object_table *table)
+{
+	int gene;
+
+	sums->count += __builtin_popcountll(word);
+	while (word) {
+		gene = (j << 6) + __builtin_ctzll(word);
+		sums->weight += table->weights[gene];
+		sums->profit += table->profits[gene];
+		word &= word - 1;
+	}
+}
+
+// scalar kernel, only the set bits of every word are visited
+fitness_sums fitness_kernel_scalar(const uint64_t *chromosomes, int first_word,
+	int nr_words, const object_table *table)
+{
+	fitness_sums sums = {0, 0, 0};
+
+	for (int j = first_word; j < first_word + nr_words; j++) {
+		add_word_sums(&sums, chromosomes[j], j, table);
+	}
+
+	return sums;
+}
+
+// AVX2 kernel, every byte of a word is expanded into a mask
+// of 8 lanes which selects the weights and the profits that
+// are added to the accumulators
+TARGET_AVX2
+fitness_sums fitness_kernel_avx2(const uint64_t *chromosomes, int first_word,
+	int nr_words, const object_table *table)
+{
+	fitness_sums sums = {0, 0, 0};
+	const __m256i bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+	__m256i weight = _mm256_setzero_si256();
+	__m256i profit = _mm256_setzero_si256();
+	__m256i mask;
+	uint64_t word;
+	int base;
+
+	for (int j = first_word; j < first_word + nr_words; j++) {
+		word = chromosomes[j];
+		if (word == 0) {
+			continue;
+		}
+
+		sums.count += _mm_popcnt_u64(word);
+		base = j << 6;
+		for (int b = 0; b < 64; b += 8) {
+			mask = _mm256_and_si256(_mm256_set1_epi32((int) (word >> b) & 0xff), bits);
+			mask = _mm256_cmpeq_epi32(mask, bits);
+			weight = _mm256_add_epi32(weight, _mm256_and_si256(mask,
+				_mm256_load_si256((const __m256i *) (table->weights + base + b))));
+			profit = _mm256_add_epi32(profit, _mm256_and_si256(mask,
+				_mm256_load_si256((const __m256i *) (table->profits + base + b))));
+		}
+	}
+
+	// horizontal sums of the two accumulators
+	__m128i w = _mm_add_epi32(_mm256_castsi256_si128(weight), _mm256_extracti128_si256(weight, 1));
+	__m128i p = _mm_add_epi32(_mm256_castsi256_si128(profit), _mm256_extracti128_si256(profit, 1));
+	w = _mm_hadd_epi32(w, p);
+	w = _mm_hadd_epi32(w, w);
+	sums.weight = _mm_extract_epi32(w, 0);
+	sums.profit = _mm_extract_epi32(w, 1);
+
+	return sums;
+}
+
+// AVX-512 kernel, every 16 bits of a word are used directly
+// as the mask of a masked add
+TARGET_AVX512
+fitness_sums fitness_kernel_avx512(const uint64_t *chromosomes, int first_word,
+	int nr_words, const object_table *table)
+{
+	fitness_sums sums = {0, 0, 0};
+	__m512i weight = _mm512_setzero_si512();
+	__m512i profit = _mm512_setzero_si512();
+	__mmask16 mask;
+	uint64_t word;
+	int base;
+
+	for (int j = first_word; j < first_word + nr_words; j++) {
+		word = chromosomes[j];
+		if (word == 0) {
+			continue;
+		}
+
+		sums.count += _mm_popcnt_u64(word);
+		base = j << 6;
+		for (int b = 0; b < 64; b += 16) {
+			mask = (__mmask16) (word >> b);
+			weight = _mm512_mask_add_epi32(weight, mask, weight,
+				_mm512_load_si512(table->weights + base + b));
+			profit = _mm512_mask_add_epi32(profit, mask, profit,
+				_mm512_load_si512(table->profits + base + b));
+		}
+	}
+
+	sums.weight = _mm512_reduce_add_epi32(weight);
+	sums.profit = _mm512_reduce_add_epi32(profit);
+
+	return sums;
+}
+
+// the kernel used by the algorithm, chosen once at startup
+// (see select_kernels)
+fitness_kernel_fn fitness_kernel = fitness_kernel_scalar;
+
+// sums of the objects selected by the genes from [start, end)
+// the whole words are summed by the kernel, the two partial words
+// at the ends of the range are masked
+fitness_sums range_sums(const uint64_t *chromosomes, int start, int end,
+	const object_table *table)
+{
+	fitness_sums sums = {0, 0, 0}, full;
+	int first, last;
+	uint64_t head, tail;
+
+	if (start >= end) {
+		return sums;
+	}
+
+	first = start >> 6;
+	last = (end - 1) >> 6;
+	head = ~0ULL << (start & 63);
+	tail = ~0ULL >> (63 - ((end - 1) & 63));
+
+	if (first == last) {
+		add_word_sums(&sums, chromosomes[first] & head & tail, first, table);
+		return sums;
+	}
+
+	add_word_sums(&sums, chromosomes[first] & head, first, table);
+	add_word_sums(&sums, chromosomes[last] & tail, last, table);
+	if (last - first > 1) {
+		full = fitness_kernel(chromosomes, first + 1, last - first - 1, table);
+		sums.weight += full.weight;
+		sums.profit += full.profit;
+		sums.count += full.count;
+	}
+
+	return sums;
+}
+
+#endif
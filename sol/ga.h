@@ -0,0 +1,120 @@
+#ifndef GA_H
+#define GA_H
+
+#include <stdint.h>
+
+// the interface of libga (make lib), the genetic algorithm of tema1_par
+// as a library: an engine is created once with its settings and then
+// solves instances, one at a time with all its threads or in batches,
+// the threads of the engine taking the instances of the batch one by
+// one, every instance being solved by a single thread
+// the results are returned, nothing is printed, a failure being
+// reported by the error of the result (see ga_error_message)
+
+// the ways in which a generation can be sorted
+#define GA_SORT_MERGE 0
+#define GA_SORT_TOPK 1
+#define GA_SORT_RADIX 2
+
+// the topologies of the migrations between islands
+#define GA_MIGRATION_RING 0
+#define GA_MIGRATION_ALL 1
+
+// how the first generation is built: one object for every individual,
+// greedily by the profit / weight ratio from that object, or greedily
+// skipping every object with a probability of 1/2
+#define GA_SEEDING_SINGLE 0
+#define GA_SEEDING_GREEDY 1
+#define GA_SEEDING_RANDOM 2
+
+// why a run failed
+#define GA_OK 0
+#define GA_ERROR_MEMORY 1
+#define GA_ERROR_THREADS 2
+#define GA_ERROR_INSTANCE 3
+#define GA_ERROR_ISLANDS 4
+#define GA_ERROR_RESUME 5
+#define GA_ERROR_CHECKPOINT 6
+#define GA_ERROR_TOPOLOGY 7
+#define GA_ERROR_CPUS 8
+#define GA_ERROR_PROCESSES 9
+
+// the settings of an engine, see ga_default_config
+// (a population size of 0 means one individual for every object,
+// a number of migrants of 0 means 5% of an island, a stagnation or
+// a time limit of 0 and a target of -1 do not stop the generations;
+// repair takes the objects of the lowest ratios out of the children
+// that are too heavy)
+typedef struct _ga_config {
+	int nr_generations;
+	int nr_threads;
+	int sort_mode;
+	int population_size;
+	int nr_islands;
+	int migration_interval;
+	int migration_topology;
+	int nr_migrants;
+	int huge_pages;
+	int stagnation;
+	int target;
+	double time_limit;
+	int repair;
+	int seeding;
+	uint64_t random_seed;
+} ga_config;
+
+// an instance of the knapsack problem, the arrays being read only
+typedef struct _ga_instance {
+	const int *weights;
+	const int *profits;
+	int nr_objects;
+	int capacity;
+} ga_instance;
+
+// the best individual of the last generation: its fitness and totals,
+// the generation after which the generations stopped (-1 if they all
+// ran), the duration of the run and the genes of the individual, 64
+// per word (object i is in the sack if bit i % 64 of word i / 64 is
+// set), freed by ga_free_result; error is GA_OK, or why the run failed
+typedef struct _ga_result {
+	int error;
+	int best_fitness;
+	int profit;
+	int weight;
+	int count;
+	int stopped_at;
+	int nr_objects;
+	uint64_t elapsed_ns;
+	uint64_t *genes;
+} ga_result;
+
+typedef struct _ga_engine ga_engine;
+
+#define GA_API __attribute__((visibility("default")))
+
+GA_API void ga_default_config(ga_config *config);
+
+// returns NULL if the settings are not valid
+GA_API ga_engine *ga_create(const ga_config *config);
+GA_API void ga_destroy(ga_engine *engine);
+
+// return 1 on success and 0 on failure (the result is then empty,
+// but for its error)
+GA_API int ga_solve(ga_engine *engine, const ga_instance *instance, ga_result *result);
+
+// solves nr_instances instances at once, returns the number of
+// instances that were solved
+GA_API int ga_solve_batch(ga_engine *engine, const ga_instance *instances, int nr_instances,
+	ga_result *results);
+
+GA_API void ga_free_result(ga_result *result);
+
+// a description of an error of a result
+GA_API const char *ga_error_message(int error);
+
+static inline int ga_result_has_object(const ga_result *result, int i)
+{
+	return (result->genes[i >> 6] >> (i & 63)) & 1;
+}
+
+#endif
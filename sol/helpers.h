@@ -5,43 +5,162 @@
 #include <string.h>
 #include <stdlib.h>
 #include <math.h>
+#include <stdint.h>
 #include <pthread.h>
-
-// structure for the object to be put in the sack
-typedef struct _sack_object {
-    int weight;
-    int profit;
-} sack_object;
-
-// structure for an individual in the genetic algorithm
-// the chromosomes are an array corresponding to each sack
-// object, in order, where 1 means that the object is in
-// the sack, 0 that it is not
-
-// I added the count member so that I can keep track of the
-// non-zero chromosomes
-typedef struct _individual {
-	int fitness;
-	int *chromosomes;
-    int chromosome_length;
-	int index;
-	int count;
-} individual;
+#include <signal.h>
+#include <sys/wait.h>
+#include "sack_object.h"
+#include "fitness.h"
+#include "kernels.h"
+#include "input.h"
+#include "arena.h"
+#include "chromosome_pool.h"
+#include "individual.h"
+#include "sort.h"
+#include "work_pool.h"
+#include "profile.h"
+#include "shared_islands.h"
+#include "checkpoint.h"
+#include "stop_policy.h"
+#include "ga.h"
+#include "logger.h"
+#include "repair.h"
+#include "affinity.h"
+
+// the ways in which a generation can be sorted
+#define SORT_MERGE GA_SORT_MERGE
+#define SORT_TOPK GA_SORT_TOPK
+#define SORT_RADIX GA_SORT_RADIX
+
+// the topologies of the migrations between islands
+#define MIGRATION_RING GA_MIGRATION_RING
+#define MIGRATION_ALL GA_MIGRATION_ALL
+
+// the crossovers of the generations: the pairs of parents with the same
+// chromosomes (frequent once the population converges) are not crossed
+// over, their children simply share the chromosomes of the parents
+// the totals, kept up to date by every operator, are the key that is
+// compared first and the chromosomes are compared only if they match;
+// a pair is a hit (same chromosomes, skipped), a miss (other totals, no
+// comparison of the chromosomes) or a false match of the key (same
+// totals, other chromosomes, compared for nothing) - the totals are a
+// weak key, on in4 most of the pairs that are crossed are false matches
+typedef struct _crossover_stats {
+	_Atomic unsigned long long pairs;
+	_Atomic unsigned long long hits;
+	_Atomic unsigned long long misses;
+	_Atomic unsigned long long false_matches;
+} crossover_stats;
+
+// the optional settings given on the command line
+// after the number of threads
+// (a population size of 0 means one individual for every object,
+// a number of migrants of 0 means 5% of an island)
+typedef struct _ga_options {
+	int huge_pages;
+	int sort_mode;
+	int population_size;
+	int nr_islands;
+	int migration_interval;
+	int migration_topology;
+	int nr_migrants;
+	int nr_processes;
+	// set by the coordinator for each of its worker processes
+	int worker_id;
+	shared_islands *shared;
+	const char *checkpoint_path;
+	int checkpoint_interval;
+	const char *resume_path;
+	stop_policy stop;
+	int crossover_stats;
+	// nothing is printed while the generations run (libga)
+	int quiet;
+	int log_format;
+	int repair;
+	int seeding;
+	uint64_t random_seed;
+	// the instruction set of the kernels (ISA_AUTO for the best one
+	// supported by the cpu) and whether the chosen one is printed
+	int isa;
+	int print_isa;
+	// how the threads are pinned (AFFINITY_*), with the list of cpus
+	// of AFFINITY_LIST
+	int affinity;
+	const char *affinity_list;
+	// the barrier of the threads (BARRIER_*)
+	int barrier;
+} ga_options;
+
+// a subpopulation evolved by its own group of threads, with its own
+// barrier, work pool, sort buffers and chromosomes; without the island
+// mode there is a single island with the whole population and all the
+// threads
+// the leader (thread 0) of the island publishes its current generation
+// and its best fitness, which the other islands read only between two
+// barriers of all the threads
+typedef struct _island {
+	individual *current_generation;
+	individual *next_generation;
+	individual *prev_generation;
+	population_arena arenas[2];
+	chromosome_pool chromosomes;
+	selection_state selection;
+	work_pool pool;
+	thread_barrier barrier;
+	int population_size;
+	int first_individual;
+	int nr_threads;
+	int first_thread;
+	individual *published;
+	int best_fitness;
+	crossover_stats crossovers;
+} __attribute__((aligned(64))) island;
 
 // struct that is being passed as argument to the thread functin
+// (index is the id of the thread inside its island)
 typedef struct _generation_info {
     int index;
+	int global_index;
     int capacity;
 	int nr_threads;
-	int square_length;
+	int sort_mode;
     int *nr_generations;
     int *nr_objects;
+	int population_size;
 	individual *current_generation;
 	individual *next_generation;
 	individual *prev_generation;
-    sack_object *objects;
-	pthread_barrier_t *barrier;
+	population_arena *current_arena;
+	population_arena *next_arena;
+	chromosome_pool *chromosomes;
+	crossover_stats *crossovers;
+	selection_state *selection;
+	work_pool *pool;
+    object_table *table;
+	thread_barrier *barrier;
 	pthread_t *threads;
+	island *islands;
+	int island_id;
+	int nr_islands;
+	int first_individual;
+	int total_population;
+	thread_barrier *global_barrier;
+	const ga_options *opts;
+	char *migrant_buffer;
+	uint64_t *last_sequences;
+	checkpoint_writer *checkpoint;
+	char *resume;
+	int first_generation;
+	stop_state *stop;
+	ga_result *result;
+	progress_logger *logger;
+	const int *ratio_order;
+	// the gate the created threads wait at (NULL for the calling thread)
+	start_gate *gate;
+	// the cpu of the thread (-1 if it is not pinned) and the
+	// rounding of the bounds of its slice
+	int cpu;
+	int slice_align;
 } generation_info;
 
 // structure passed as argument to
@@ -49,71 +168,292 @@ typedef struct _generation_info {
 typedef struct _info {
 	int id;
 	int count;
-	pthread_barrier_t *barrier;
+	thread_barrier *barrier;
 	individual **v;
 	individual **v_prev;
-	int square_length;
 	int actual_length;
 	int nr_threads;
+	int sort_mode;
+	int top;
+	selection_state *selection;
+	work_pool *pool;
 } info;
 
+// the arguments of the tasks of a phase run by the work pool
+typedef struct _phase_args {
+	const individual *source;
+	individual *destination;
+	int length;
+	int width;
+	int generation_index;
+	const object_table *table;
+	chromosome_pool *chromosomes;
+	crossover_stats *crossovers;
+	// the objects by ratio, when the children are repaired
+	const int *ratio_order;
+	int capacity;
+} phase_args;
+
+
+// flips the genes from [start, end) by a given step and
+// updates the totals of the individual with the flipped objects
+// for step 1 whole words are flipped at once
+void flip_genes(individual *ind, int start, int end, int step,
+	const object_table *table)
+{
+	uint64_t *chromosomes = ind->chromosomes;
+	fitness_sums old_sums;
+	int sign;
+
+	if (step != 1) {
+		for (int i = start; i < end; i += step) {
+			// +1 if the object is put in the sack, -1 if it is removed
+			sign = 1 - 2 * get_gene(chromosomes, i);
+			ind->weight += sign * table->weights[i];
+			ind->profit += sign * table->profits[i];
+			ind->count += sign;
+			flip_gene(chromosomes, i);
+		}
+		return;
+	}
+
+	// the objects of the range that were in the sack are removed
+	// and all the others from the range are added
+	old_sums = range_sums(chromosomes, start, end, table);
+	ind->weight += table->weight_prefix[end] - table->weight_prefix[start] - 2 * old_sums.weight;
+	ind->profit += table->profit_prefix[end] - table->profit_prefix[start] - 2 * old_sums.profit;
+	ind->count += end - start - 2 * old_sums.count;
+
+	while (start < end && (start & 63)) {
+		flip_gene(chromosomes, start++);
+	}
+	complement_kernel(chromosomes + (start >> 6), (end - start) >> 6);
+	start += (end - start) & ~63;
+	while (start < end) {
+		flip_gene(chromosomes, start++);
+	}
+}
 
 // the read input function
-// similar to the one given in the skel
-int read_input(sack_object **objects, int *nr_objects, int *capacity,
+// the instance is loaded by input.h, either from a text file
+// (parsed by nr_threads threads) or from a binary one
+int read_input(object_table *table, int *capacity,
                 int *nr_gen, int *nr_threads, int argc, char *argv[])
 {
-	FILE *fp;
-
 	if (argc < 4) {
 		fprintf(stderr, "Usage:\n\t./tema1 in_file generations_count\n");
 		return 0;
 	}
 
-	fp = fopen(argv[1], "r");
-	if (fp == NULL) {
+	*nr_gen = (int) strtol(argv[2], NULL, 10);
+	
+	if (*nr_gen == 0) {
 		return 0;
 	}
 
-	if (fscanf(fp, "%d %d", nr_objects, capacity) < 2) {
-		fclose(fp);
+    *nr_threads = (int) strtol(argv[3], NULL, 10);
+	
+	if (*nr_threads <= 0) {
 		return 0;
 	}
 
-	if (*nr_objects % 10) {
-		fclose(fp);
+	if (!load_instance(argv[1], table, capacity, *nr_threads)) {
 		return 0;
 	}
 
-	sack_object *tmp_objects;
-    tmp_objects = (sack_object *) calloc(*nr_objects, sizeof(sack_object));
-
-	for (int i = 0; i < *nr_objects; ++i) {
-		if (fscanf(fp, "%d %d", &tmp_objects[i].profit, &tmp_objects[i].weight) < 2) {
-			free(objects);
-			fclose(fp);
-			return 0;
-		}
+	// the step of the mutations is taken modulo N - 2
+	if (table->nr_objects < 3) {
+		free_object_table(table);
+		return 0;
 	}
 
-	fclose(fp);
+	return 1;
+}
 
-	*nr_gen = (int) strtol(argv[2], NULL, 10);
-	
-	if (*nr_gen == 0) {
-		free(tmp_objects);
-		return 0;
+// reads the optional settings that follow the number of threads
+// (--huge-pages backs the chromosomes by transparent huge pages,
+// --sort=merge|topk|radix chooses how the generations are sorted,
+// --population=M sets the number of individuals of a generation,
+// --islands=I splits them in I islands, which exchange their best
+// individuals every --migration-interval=G generations, over a
+// --topology=ring|all, --migrants=m at a time; --processes=W runs W
+// worker processes, which exchange migrants in the same way through
+// shared memory; --checkpoint=file saves the state of the algorithm every
+// --checkpoint-interval=G generations and --resume=file continues from it;
+// the generations stop early after --stagnation=W generations without
+// a better fitness, at a --target=F fitness or after --time-limit=S
+// seconds, the best individual being printed after its fitness;
+// --crossover-stats prints how many crossovers were skipped;
+// --log-format=text|csv|jsonl chooses how the progress is printed;
+// --repair takes the objects of the lowest profit / weight ratios out
+// of the children that are too heavy and --seeding=single|greedy|random
+// builds the first generation from one object for every individual, or
+// greedily, deterministically or randomly (from --random-seed=S);
+// --isa=auto|scalar|avx2|avx512 chooses the variant of the kernels
+// (by default the best one supported by the cpu) and --print-isa
+// prints the one that was chosen; --affinity=compact|scatter|LIST pins
+// the threads to the cpus, filling the cores of a socket one after
+// another, spreading them over the sockets and the cores or on the cpus
+// of a list such as 0,2,4-7, and prints where they were placed;
+// --barrier=pthread|spin|dissemination chooses the barrier of the
+// threads, the one of pthreads, a centralized spin barrier or a
+// dissemination barrier that spins and then sleeps)
+int read_options(ga_options *opts, int argc, char *argv[])
+{
+	char *end;
+
+	memset(opts, 0, sizeof(ga_options));
+	opts->sort_mode = SORT_TOPK;
+	opts->nr_islands = 1;
+	opts->migration_interval = 10;
+	opts->migration_topology = MIGRATION_RING;
+	opts->nr_processes = 1;
+	opts->checkpoint_interval = 100;
+	opts->stop.target = -1;
+	opts->seeding = SEEDING_SINGLE;
+	opts->random_seed = 1;
+	opts->isa = ISA_AUTO;
+	opts->affinity = AFFINITY_NONE;
+	opts->barrier = BARRIER_PTHREAD;
+
+	for (int i = 4; i < argc; i++) {
+		if (!strcmp(argv[i], "--huge-pages")) {
+			opts->huge_pages = 1;
+		} else if (!strcmp(argv[i], "--sort=merge")) {
+			opts->sort_mode = SORT_MERGE;
+		} else if (!strcmp(argv[i], "--sort=topk")) {
+			opts->sort_mode = SORT_TOPK;
+		} else if (!strcmp(argv[i], "--sort=radix")) {
+			opts->sort_mode = SORT_RADIX;
+		} else if (!strncmp(argv[i], "--population=", 13)) {
+			opts->population_size = (int) strtol(argv[i] + 13, &end, 10);
+			if (*end != '\0' || opts->population_size <= 0) {
+				fprintf(stderr, "Dimensiune invalida a populatiei: %s\n", argv[i] + 13);
+				return 0;
+			}
+		} else if (!strncmp(argv[i], "--islands=", 10)) {
+			opts->nr_islands = (int) strtol(argv[i] + 10, &end, 10);
+			if (*end != '\0' || opts->nr_islands <= 0) {
+				fprintf(stderr, "Numar invalid de insule: %s\n", argv[i] + 10);
+				return 0;
+			}
+		} else if (!strncmp(argv[i], "--migration-interval=", 21)) {
+			opts->migration_interval = (int) strtol(argv[i] + 21, &end, 10);
+			if (*end != '\0' || opts->migration_interval <= 0) {
+				fprintf(stderr, "Interval de migrare invalid: %s\n", argv[i] + 21);
+				return 0;
+			}
+		} else if (!strncmp(argv[i], "--migrants=", 11)) {
+			opts->nr_migrants = (int) strtol(argv[i] + 11, &end, 10);
+			if (*end != '\0' || opts->nr_migrants <= 0) {
+				fprintf(stderr, "Numar invalid de migranti: %s\n", argv[i] + 11);
+				return 0;
+			}
+		} else if (!strncmp(argv[i], "--processes=", 12)) {
+			opts->nr_processes = (int) strtol(argv[i] + 12, &end, 10);
+			if (*end != '\0' || opts->nr_processes <= 0) {
+				fprintf(stderr, "Numar invalid de procese: %s\n", argv[i] + 12);
+				return 0;
+			}
+		} else if (!strncmp(argv[i], "--checkpoint=", 13)) {
+			opts->checkpoint_path = argv[i] + 13;
+		} else if (!strncmp(argv[i], "--checkpoint-interval=", 22)) {
+			opts->checkpoint_interval = (int) strtol(argv[i] + 22, &end, 10);
+			if (*end != '\0' || opts->checkpoint_interval <= 0) {
+				fprintf(stderr, "Interval de checkpoint invalid: %s\n", argv[i] + 22);
+				return 0;
+			}
+		} else if (!strncmp(argv[i], "--stagnation=", 13)) {
+			opts->stop.stagnation = (int) strtol(argv[i] + 13, &end, 10);
+			if (*end != '\0' || opts->stop.stagnation <= 0) {
+				fprintf(stderr, "Numar invalid de generatii de stagnare: %s\n", argv[i] + 13);
+				return 0;
+			}
+		} else if (!strncmp(argv[i], "--target=", 9)) {
+			opts->stop.target = (int) strtol(argv[i] + 9, &end, 10);
+			if (*end != '\0' || opts->stop.target < 0) {
+				fprintf(stderr, "Fitness tinta invalid: %s\n", argv[i] + 9);
+				return 0;
+			}
+		} else if (!strncmp(argv[i], "--time-limit=", 13)) {
+			opts->stop.time_limit = strtod(argv[i] + 13, &end);
+			if (*end != '\0' || opts->stop.time_limit <= 0) {
+				fprintf(stderr, "Limita de timp invalida: %s\n", argv[i] + 13);
+				return 0;
+			}
+		} else if (!strcmp(argv[i], "--log-format=text")) {
+			opts->log_format = LOG_TEXT;
+		} else if (!strcmp(argv[i], "--log-format=csv")) {
+			opts->log_format = LOG_CSV;
+		} else if (!strcmp(argv[i], "--log-format=jsonl")) {
+			opts->log_format = LOG_JSONL;
+		} else if (!strcmp(argv[i], "--repair")) {
+			opts->repair = 1;
+		} else if (!strcmp(argv[i], "--seeding=single")) {
+			opts->seeding = SEEDING_SINGLE;
+		} else if (!strcmp(argv[i], "--seeding=greedy")) {
+			opts->seeding = SEEDING_GREEDY;
+		} else if (!strcmp(argv[i], "--seeding=random")) {
+			opts->seeding = SEEDING_RANDOM;
+		} else if (!strncmp(argv[i], "--random-seed=", 14)) {
+			opts->random_seed = strtoull(argv[i] + 14, &end, 10);
+			if (*end != '\0' || argv[i][14] == '\0') {
+				fprintf(stderr, "Samanta invalida: %s\n", argv[i] + 14);
+				return 0;
+			}
+		} else if (!strncmp(argv[i], "--isa=", 6)) {
+			opts->isa = parse_isa(argv[i] + 6);
+			if (opts->isa == -2) {
+				fprintf(stderr, "Set de instructiuni necunoscut: %s\n", argv[i] + 6);
+				return 0;
+			}
+			if (opts->isa != ISA_AUTO && !isa_supported(opts->isa)) {
+				fprintf(stderr, "Procesorul nu suporta setul de instructiuni %s\n", argv[i] + 6);
+				return 0;
+			}
+		} else if (!strcmp(argv[i], "--affinity=none")) {
+			opts->affinity = AFFINITY_NONE;
+		} else if (!strcmp(argv[i], "--affinity=compact")) {
+			opts->affinity = AFFINITY_COMPACT;
+		} else if (!strcmp(argv[i], "--affinity=scatter")) {
+			opts->affinity = AFFINITY_SCATTER;
+		} else if (!strncmp(argv[i], "--affinity=", 11)) {
+			int cpus[AFFINITY_MAX_CPUS];
+
+			if (!parse_cpu_list(argv[i] + 11, cpus, AFFINITY_MAX_CPUS)) {
+				fprintf(stderr, "Lista invalida de cpu-uri: %s\n", argv[i] + 11);
+				return 0;
+			}
+			opts->affinity = AFFINITY_LIST;
+			opts->affinity_list = argv[i] + 11;
+		} else if (!strcmp(argv[i], "--barrier=pthread")) {
+			opts->barrier = BARRIER_PTHREAD;
+		} else if (!strcmp(argv[i], "--barrier=spin")) {
+			opts->barrier = BARRIER_SPIN;
+		} else if (!strcmp(argv[i], "--barrier=dissemination")) {
+			opts->barrier = BARRIER_DISSEMINATION;
+		} else if (!strcmp(argv[i], "--print-isa")) {
+			opts->print_isa = 1;
+		} else if (!strcmp(argv[i], "--crossover-stats")) {
+			opts->crossover_stats = 1;
+		} else if (!strncmp(argv[i], "--resume=", 9)) {
+			opts->resume_path = argv[i] + 9;
+		} else if (!strcmp(argv[i], "--topology=ring")) {
+			opts->migration_topology = MIGRATION_RING;
+		} else if (!strcmp(argv[i], "--topology=all")) {
+			opts->migration_topology = MIGRATION_ALL;
+		} else {
+			fprintf(stderr, "Optiune necunoscuta: %s\n", argv[i]);
+			return 0;
+		}
 	}
 
-    *nr_threads = (int) strtol(argv[3], NULL, 10);
-	
-	if (*nr_threads == 0) {
-		free(tmp_objects);
+	// the outboxes of the workers are not part of a checkpoint
+	if (opts->nr_processes > 1 && (opts->checkpoint_path != NULL || opts->resume_path != NULL)) {
+		fprintf(stderr, "Checkpoint-urile nu pot fi folosite cu mai multe procese\n");
 		return 0;
 	}
 
-	*objects = tmp_objects;
-
 	return 1;
 }
 
@@ -122,10 +462,92 @@ void print_best_fitness(const individual *generation)
 	printf("%d\n", generation[0].fitness);
 }
 
-void print_objects(const sack_object *objects, int nr_objects)
+// the final result, in the format of the progress, as the record of
+// the generation after the last one that ran
+void print_final_fitness(const ga_result *result, int nr_gen, int format)
+{
+	progress_record record;
+	char line[128];
+
+	record.generation = result->stopped_at >= 0 ? result->stopped_at + 1 : nr_gen;
+	record.best_fitness = result->best_fitness;
+	record.ns = result->elapsed_ns;
+	format_progress_record(line, sizeof(line), format, &record);
+	fputs(line, stdout);
+}
+
+// the best individual, printed when a stop policy is used: the
+// generation after which the loop was left (-1 if it was not), its
+// totals and the objects in the sack
+void print_best_individual(const ga_result *result)
+{
+	printf("%d %d %d %d\n", result->stopped_at, result->profit, result->weight, result->count);
+	for (int i = 0; i < result->nr_objects; ++i) {
+		if (ga_result_has_object(result, i))
+			printf("%d ", i);
+	}
+	printf("\n");
+}
+
+// the result of a run is its best individual, with a copy of its
+// genes (left NULL if it cannot be allocated)
+void store_result(ga_result *result, const individual *best, int stopped_at)
 {
-	for (int i = 0; i < nr_objects; ++i) {
-		printf("%d %d\n", objects[i].weight, objects[i].profit);
+	size_t size = chromosome_words(best->chromosome_length) * sizeof(uint64_t);
+
+	result->best_fitness = best->fitness;
+	result->profit = best->profit;
+	result->weight = best->weight;
+	result->count = best->count;
+	result->stopped_at = stopped_at;
+	result->nr_objects = best->chromosome_length;
+	result->genes = malloc(size);
+	if (result->genes != NULL)
+		memcpy(result->genes, best->chromosomes, size);
+}
+
+void ga_free_result(ga_result *result)
+{
+	free(result->genes);
+	result->genes = NULL;
+}
+
+const char *ga_error_message(int error)
+{
+	static const char *messages[] = {
+		"Nicio eroare",
+		"Eroare la alocarea memoriei",
+		"Eroare la crearea thread-urilor",
+		"Instanta invalida",
+		"Prea multe insule pentru numarul de thread-uri si de indivizi",
+		"Checkpoint invalid",
+		"Eroare la pornirea checkpoint-urilor",
+		"Topologia procesorului nu a putut fi citita",
+		"Cpu-urile cerute nu sunt disponibile",
+		"Eroare la crearea proceselor",
+	};
+
+	if (error < 0 || error >= (int) (sizeof(messages) / sizeof(messages[0])))
+		return "Eroare necunoscuta";
+	return messages[error];
+}
+
+// the error of a run that failed, printed by tema1_par (the library
+// only returns it)
+void print_run_error(const ga_result *result, const ga_options *opts)
+{
+	if (result->error == GA_ERROR_RESUME)
+		fprintf(stderr, "%s: %s\n", ga_error_message(result->error), opts->resume_path);
+	else if (result->error == GA_ERROR_CPUS)
+		fprintf(stderr, "%s: %s\n", ga_error_message(result->error), opts->affinity_list);
+	else
+		fprintf(stderr, "%s\n", ga_error_message(result->error));
+}
+
+void print_objects(const object_table *table)
+{
+	for (int i = 0; i < table->nr_objects; ++i) {
+		printf("%d %d\n", table->weights[i], table->profits[i]);
 	}
 }
 
@@ -133,7 +555,7 @@ void print_generation(const individual *generation, int limit)
 {
 	for (int i = 0; i < limit; ++i) {
 		for (int j = 0; j < generation[i].chromosome_length; ++j) {
-			printf("%d ", generation[i].chromosomes[j]);
+			printf("%d ", get_gene(generation[i].chromosomes, j));
 		}
 
 		printf("\n%d - %d\n", i, generation[i].fitness);
@@ -142,103 +564,186 @@ void print_generation(const individual *generation, int limit)
 
 // mutate bit string 1 function - as implemented in the
 // skel given by the APD team
-void mutate_bit_string_1(const individual *ind, int generation_index)
+void mutate_bit_string_1(individual *ind, int generation_index, const object_table *table)
 {
-	int i, mutation_size;
+	int mutation_size;
 	int step = 1 + generation_index % (ind->chromosome_length - 2);
 
 	if (ind->index % 2 == 0) {
 		// for even-indexed individuals, mutate the first 40% chromosomes by a given step
 		mutation_size = ind->chromosome_length * 4 / 10;
-		for (i = 0; i < mutation_size; i += step) {
-			ind->chromosomes[i] = 1 - ind->chromosomes[i];
-		}
+		flip_genes(ind, 0, mutation_size, step, table);
 	} else {
 		// for even-indexed individuals, mutate the last 80% chromosomes by a given step
 		mutation_size = ind->chromosome_length * 8 / 10;
-		for (i = ind->chromosome_length - mutation_size; i < ind->chromosome_length; i += step) {
-			ind->chromosomes[i] = 1 - ind->chromosomes[i];
-		}
+		flip_genes(ind, ind->chromosome_length - mutation_size,
+			ind->chromosome_length, step, table);
 	}
 }
 
 // mutate bit string 2 function - as implemented in the
 // skel given by the APD team
-void mutate_bit_string_2(const individual *ind, int generation_index)
+void mutate_bit_string_2(individual *ind, int generation_index, const object_table *table)
 {
 	int step = 1 + generation_index % (ind->chromosome_length - 2);
 
 	// mutate all chromosomes by a given step
-	for (int i = 0; i < ind->chromosome_length; i += step) {
-		ind->chromosomes[i] = 1 - ind->chromosomes[i];
-	}
+	flip_genes(ind, 0, ind->chromosome_length, step, table);
 }
 
 // crossover function - as implemented in the
 // skel given by the APD team
-void crossover(individual *parent1, individual *child1, int generation_index)
+// the totals of the children are the totals of the parents with
+// the shorter of the two spliced ranges exchanged between them
+void crossover(const individual *parent1, individual *child1, int generation_index,
+	const object_table *table)
 {
-	individual *parent2 = parent1 + 1;
+	const individual *parent2 = parent1 + 1;
 	individual *child2 = child1 + 1;
 	int count = 1 + generation_index % parent1->chromosome_length;
+	int nr_words = chromosome_words(parent1->chromosome_length);
+	fitness_sums sums1, sums2;
+	const individual *base1 = parent1, *base2 = parent2;
+
+	if (count <= parent1->chromosome_length - count) {
+		// the heads are exchanged, child1 = parent2 with the head of parent1
+		sums1 = range_sums(parent1->chromosomes, 0, count, table);
+		sums2 = range_sums(parent2->chromosomes, 0, count, table);
+		base1 = parent2;
+		base2 = parent1;
+	} else {
+		// the tails are exchanged, child1 = parent1 with the tail of parent2
+		sums1 = range_sums(parent2->chromosomes, count, parent1->chromosome_length, table);
+		sums2 = range_sums(parent1->chromosomes, count, parent1->chromosome_length, table);
+	}
 
-	memcpy(child1->chromosomes, parent1->chromosomes, count * sizeof(int));
-	memcpy(child1->chromosomes + count, parent2->chromosomes + count, (parent1->chromosome_length - count) * sizeof(int));
-
-	memcpy(child2->chromosomes, parent2->chromosomes, count * sizeof(int));
-	memcpy(child2->chromosomes + count, parent1->chromosomes + count, (parent1->chromosome_length - count) * sizeof(int));
+	child1->weight = base1->weight + sums1.weight - sums2.weight;
+	child1->profit = base1->profit + sums1.profit - sums2.profit;
+	child1->count = base1->count + sums1.count - sums2.count;
+	child2->weight = base2->weight + sums2.weight - sums1.weight;
+	child2->profit = base2->profit + sums2.profit - sums1.profit;
+	child2->count = base2->count + sums2.count - sums1.count;
+
+	// the first count genes of each child come from its own parent,
+	// the rest from the other one
+	splice_kernel(child1->chromosomes, parent1->chromosomes, parent2->chromosomes, count, nr_words);
+	splice_kernel(child2->chromosomes, parent2->chromosomes, parent1->chromosomes, count, nr_words);
 }
 
 // copy individual function as implemented in the skel received
 // from the APD team
-void copy_individual(const individual *from, const individual *to)
+void copy_individual(const individual *from, individual *to)
 {
-	memcpy(to->chromosomes, from->chromosomes, from->chromosome_length * sizeof(int));
+	copy_kernel(to->chromosomes, from->chromosomes, chromosome_words(from->chromosome_length));
+	to->weight = from->weight;
+	to->profit = from->profit;
+	to->count = from->count;
 }
 
 // free generation function as implemented in the skel received
 // from the APD team
-void free_generation(individual *generation)
+// the chromosomes live in the arena of the generation buffer,
+// so they are released with a single unmap
+void free_generation(individual *generation, population_arena *arena)
 {
 	int i;
 
-	for (i = 0; i < generation->chromosome_length; ++i) {
-		free(generation[i].chromosomes);
+	for (i = 0; i < arena->nr_individuals; ++i) {
 		generation[i].chromosomes = NULL;
 		generation[i].fitness = 0;
 	}
+
+	free_population_arena(arena);
+}
+
+// computes the totals of an individual with a full scan of
+// its chromosomes, using the vectorized kernel chosen at startup
+void evaluate_individual(individual *ind, const object_table *table)
+{
+	fitness_sums sums = fitness_kernel(ind->chromosomes, 0,
+		chromosome_words(ind->chromosome_length), table);
+
+	ind->weight = sums.weight;
+	ind->profit = sums.profit;
+	ind->count = sums.count;
+}
+
+// the first generation: individual i of the M holds only the object
+// i * N / M, so the objects are spread evenly over the population
+// whatever its size (with M = N, individual i holds object i)
+void seed_individual(individual *ind, int i, int population_size, int nr_objects)
+{
+	set_gene(ind->chromosomes, (int) ((long long) i * nr_objects / population_size));
+}
+
+static inline int gcd(int a, int b)
+{
+	while (b) {
+		int r = a % b;
+
+		a = b;
+		b = r;
+	}
+	return a;
+}
+
+// the rounding of the slices of pinned threads: the slices start on
+// whole cache lines of the generations (the chromosomes of an individual
+// always start on a cache line) and, when they are long enough, on whole
+// pages of the chromosomes, so that no line and no page of a slice is
+// written by another thread (the pages being placed on the numa node of
+// the thread that first touches them)
+int slice_alignment(int population_size, int nr_threads, const population_arena *arena)
+{
+	int line = 64 / gcd(64, sizeof(individual));
+	int page = 4096 / gcd(4096, arena->stride * sizeof(uint64_t));
+	int both = line / gcd(line, page) * page;
+
+	return (population_size / nr_threads >= 8 * both) ? both : line;
+}
+
+#ifdef DEBUG
+// in the debug build the totals kept by the operators are checked
+// against a full scan, over the same slice as the fitness
+void check_totals(const object_table *table, const individual *generation, int population_size,
+	int id_thread, int nr_threads, int align)
+{
+	int start = slice_bound(id_thread, population_size, nr_threads, align);
+	int end = slice_bound(id_thread + 1, population_size, nr_threads, align);
+	fitness_sums sums;
+
+	for (int i = start; i < end; i++) {
+		sums = fitness_kernel(generation[i].chromosomes, 0,
+			chromosome_words(generation[i].chromosome_length), table);
+		if (sums.weight != generation[i].weight || sums.profit != generation[i].profit
+			|| sums.count != generation[i].count) {
+			fprintf(stderr, "Totaluri gresite pentru individul %d\n", i);
+			exit(-1);
+		}
+	}
 }
 
+#define CHECK_TOTALS(table, generation, population_size, id_thread, nr_threads, align) \
+	check_totals(table, generation, population_size, id_thread, nr_threads, align)
+#else
+#define CHECK_TOTALS(table, generation, population_size, id_thread, nr_threads, align)
+#endif
+
 // the compute fitness function but i parallelized it
 // I added a count member in the individual structure
 // to keep track of the non-zero chromosomes in the individual
-void compute_fitness_function_parallel(const sack_object *objects, individual *generation,
-	int nr_objects, int sack_capacity, int id_thread, int nr_threads) {
-	int weight, profit;
+// the totals are kept up to date by the operators, so here
+// only the capacity of the sack is checked
+void compute_fitness_function_parallel(individual *generation, int population_size,
+	int sack_capacity, int id_thread, int nr_threads, int align) {
 	int start, end;
-	int count;
 
 	// here I set the start and the end of the vector
-	start = id_thread * (double) nr_objects / nr_threads;
-	if ((id_thread + 1) * (double) nr_objects / nr_threads > nr_objects)
-		end = nr_objects;
-	else
-		end = (id_thread + 1) * (double) nr_objects / nr_threads;
+	start = slice_bound(id_thread, population_size, nr_threads, align);
+	end = slice_bound(id_thread + 1, population_size, nr_threads, align);
 
 	for (int i = start; i < end; i++) {
-		weight = 0;
-		profit = 0;
-		count = 0;
-
-		for (int j = 0; j < generation[i].chromosome_length; ++j) {
-			if (generation[i].chromosomes[j]) {
-				weight += objects[j].weight;
-				profit += objects[j].profit;
-				count++;
-			}
-		}
-		generation[i].count = count;
-		generation[i].fitness = (weight <= sack_capacity) ? profit : 0;
+		generation[i].fitness = (generation[i].weight <= sack_capacity) ? generation[i].profit : 0;
 	}
 }
 
@@ -280,79 +785,310 @@ void merge_intervals(individual *source, int start, int mid, int end, individual
 }
 
 
+// the task i of a mergesort step merges the two intervals of the given
+// width that start at i * 2 * width (the second one, or both, can
+// be cut, or even empty, at the end of the vector)
+void merge_task(void *arg, int start, int end)
+{
+	phase_args *args = arg;
+	int width = args->width;
+	int length = args->length;
+	int i, mid, stop;
+
+	for (int task = start; task < end; task++) {
+		i = task * 2 * width;
+		mid = (i + width < length) ? i + width : length;
+		stop = (i + 2 * width < length) ? i + 2 * width : length;
+		merge_intervals((individual *) args->source, i, mid, stop, args->destination);
+	}
+}
+
 void mergesort_parallel(info *info_ms) {
 	// getting the information nedeed from the structure
-	int thread_id = info_ms->id;
 	int actual_length = info_ms->actual_length;
-	int square_length = info_ms->square_length;
 
 	individual **vNew = info_ms->v_prev;
 	individual **v = info_ms->v;
-	int P = info_ms->nr_threads;
-
-	int start_index, end_index;
-	int start_local, end_local;
+	phase_args args;
 	int width;
 
-	// declaring an auxiliary vector for the swap between
+	// declaring an auxiliary pointer for the swap between
 	// the vectors
-	individual **aux = malloc(actual_length * sizeof(individual));
+	individual *aux;
 
-	pthread_barrier_t *barrier = info_ms->barrier;
+	thread_barrier *barrier = info_ms->barrier;
 	
 	// we advance with the width of the vectors
 	// that we are merging
-	pthread_barrier_wait(barrier);
+	wait_barrier(barrier, info_ms->id);
 	// here are the steps performed by the mergesort
 	// I gradually increase the width of the intervals which are merged
 	// this part is similar to the one at the laboratory
+	// the merges of a step are the tasks given to the work pool, so the
+	// threads left without merges steal them from the others
 	for (width = 1; width < actual_length; width = 2 * width) {
-		// here I compute the starting and ending indexes 
-		start_index = thread_id * (double) square_length / P;
-		end_index = (thread_id + 1) * (double) square_length / P;
-		// the the local index is greater than the squared length of
-		// the generation to be sorted, hten the end index (local)
-		// takes the value of this squared length
-		start_local = (start_index / (2 * width)) * (2 * width);
-		if (square_length > (end_index / (2 * width)) * (2 * width)) {
-			end_local = (end_index / (2 * width)) * (2 * width);
-		} else {
-			end_local = square_length;
-		}
-
-		// here I iterate over the indexes which are specific to the thread
-		// with the id thread_id
-		for (int i = start_local; i < end_local; i = i + 2 * width) {
-			// I have 3 cases in which I call the function that merges the intervals
-			if (i + 2 * width > actual_length && i + width > actual_length) {
-				// This is the case in which the size of the two intervals that
-				// need to be merged ar actually overflowing, the size of the vector
-				// overall is smaller. The position of the mid is also greater than
-				// the actual size. This is why I set the mid and the end to be the
-				// actual size of the vector 
-				merge_intervals(*v, i, actual_length, actual_length, *vNew);
-			} else if (i + 2 * width > actual_length && i + width <= actual_length) {
-				// The second case is just like the case above, but only the size of the
-				// second interval is overflowing, the index of the mid is ok
-				merge_intervals(*v, i, i + width, actual_length, *vNew);
-			} else {
-				// here is the default case that has been treated in the laboratory as well
-				merge_intervals(*v, i, i + width, i + 2 * width, *vNew);
-			}
-		}
+		PROFILE_BEGIN(PHASE_MERGE_STEP + __builtin_ctz(width));
+		args.source = *v;
+		args.destination = *vNew;
+		args.length = actual_length;
+		args.width = width;
+		parallel_for(info_ms->pool, info_ms->id, (actual_length + 2 * width - 1) / (2 * width),
+			merge_task, &args);
 
 		// these barrier wait calls are for assuring that
 		// all threads have finished execution of a part of code
 		// needed by all of them later
-		pthread_barrier_wait(barrier);
+		wait_barrier(barrier, info_ms->id);
  
 		// here I interchange the vectors so that I
 		// get the result in v
-		*aux = *v;
+		aux = *v;
 		*v = *vNew;
-		*vNew = *aux;
+		*vNew = aux;
+
+		wait_barrier(barrier, info_ms->id);
+		PROFILE_END();
+	}
+}
+
+// creates the children of the tasks from [start, end) of the next
+// generation, from the sorted current one
+// the slots of the children are
+//   [0, count1)                       the first 30% (elite children)
+//   [count1, count1 + count2)         the first 20% with bit string mutation 1
+//   [count1 + count2, cursor)         the next 20% with bit string mutation 2
+//   [cursor, length)                  one-point crossover of the first
+//                                     length - cursor (about 30%)
+// (if there is an odd number of parents, the worst individual
+// takes the last slot)
+// every slot before cursor is a task, after it every task is a pair
+// of crossover children, so the pair is never split between threads
+// the children that are kept as such share the chromosomes of their
+// parents, the mutated ones copy them when they are written
+void reproduce_task(void *arg, int start, int end)
+{
+	phase_args *args = arg;
+	chromosome_pool *pool = args->chromosomes;
+	const individual *current_generation = args->source;
+	individual *next_generation = args->destination;
+	int population_size = args->length;
+	int count1 = population_size * 3 / 10;
+	int count2 = population_size * 2 / 10;
+	int cursor = count1 + 2 * count2;
+	int nr_words = pool->nr_words;
+	unsigned long long pairs = 0, hits = 0, misses = 0, false_matches = 0;
+	const individual *parent;
+	int i, nr_children, identical;
+
+	for (int task = start; task < end; task++) {
+		i = (task < cursor) ? task : cursor + 2 * (task - cursor);
+		nr_children = 1;
+		if (i < count1) {
+			share_chromosomes(pool, current_generation + i, next_generation + i);
+		} else if (i < count1 + count2) {
+			share_chromosomes(pool, current_generation + i - count1, next_generation + i);
+			make_writable(pool, next_generation + i);
+			mutate_bit_string_1(next_generation + i, args->generation_index, args->table);
+		} else if (i < cursor) {
+			share_chromosomes(pool, current_generation + i - count1, next_generation + i);
+			make_writable(pool, next_generation + i);
+			mutate_bit_string_2(next_generation + i, args->generation_index, args->table);
+		} else if ((population_size - cursor) % 2 == 1 && i == population_size - 1) {
+			share_chromosomes(pool, current_generation + population_size - 1, next_generation + i);
+		} else {
+			parent = current_generation + i - cursor;
+			nr_children = 2;
+			pairs++;
+			if (parent[0].weight != parent[1].weight || parent[0].profit != parent[1].profit
+				|| parent[0].count != parent[1].count) {
+				identical = 0;
+				misses++;
+			} else {
+				identical = !memcmp(parent[0].chromosomes, parent[1].chromosomes,
+					nr_words * sizeof(uint64_t));
+				false_matches += !identical;
+			}
+			if (identical) {
+				// the children would be copies of their parents
+				share_chromosomes(pool, parent, next_generation + i);
+				share_chromosomes(pool, parent + 1, next_generation + i + 1);
+				hits++;
+			} else {
+				acquire_chromosomes(pool, next_generation + i);
+				acquire_chromosomes(pool, next_generation + i + 1);
+				crossover(parent, next_generation + i, args->generation_index, args->table);
+			}
+		}
+
+		// the children that are too heavy are repaired as soon as they
+		// are created, while the parents still hold their chromosomes
+		if (args->ratio_order != NULL) {
+			for (int c = i; c < i + nr_children; c++) {
+				repair_individual(pool, next_generation + c, args->table, args->ratio_order,
+					args->capacity);
+			}
+		}
+	}
+
+	if (pairs) {
+		atomic_fetch_add_explicit(&args->crossovers->pairs, pairs, memory_order_relaxed);
+		atomic_fetch_add_explicit(&args->crossovers->hits, hits, memory_order_relaxed);
+		atomic_fetch_add_explicit(&args->crossovers->misses, misses, memory_order_relaxed);
+		atomic_fetch_add_explicit(&args->crossovers->false_matches, false_matches, memory_order_relaxed);
+	}
+}
+
+// creates the next generation from the sorted current one in a single
+// pass, whatever operator produces the children; the tasks are shared
+// through the work pool
+void reproduce_parallel(const individual *current_generation, individual *next_generation,
+	int population_size, int generation_index, const object_table *table, chromosome_pool *chromosomes,
+	crossover_stats *crossovers, const int *ratio_order, int capacity, work_pool *pool, int id)
+{
+	int count1 = population_size * 3 / 10;
+	int count2 = population_size * 2 / 10;
+	int cursor = count1 + 2 * count2;
+	phase_args args;
+
+	args.source = current_generation;
+	args.destination = next_generation;
+	args.length = population_size;
+	args.generation_index = generation_index;
+	args.table = table;
+	args.chromosomes = chromosomes;
+	args.crossovers = crossovers;
+	args.ratio_order = ratio_order;
+	args.capacity = capacity;
+	parallel_for(pool, id, cursor + (population_size - cursor + 1) / 2, reproduce_task, &args);
+}
+
+// the immigrants of an island are the best individuals of the other
+// islands: the first elite children of their current generations, which
+// are copies of the best individuals of the generations before, in
+// order; they replace the last crossover children of the island, before
+// its fitness is computed and it is sorted
+// (the ring takes nr_migrants from the previous island, all to all
+// takes nr_migrants / (I - 1) from every other island)
+// only the leader of the island calls it, between two barriers of all
+// the threads, while no island changes its individuals
+// returns the last slot that is still free
+int migrate_island(island *islands, int nr_islands, int island_id, int topology,
+	int nr_migrants)
+{
+	island *own = &islands[island_id];
+	int count1 = own->population_size * 3 / 10;
+	int count2 = own->population_size * 2 / 10;
+	int cursor = count1 + 2 * count2;
+	int slot = own->population_size - 1;
+	int source, count;
+
+	if (nr_migrants == 0)
+		nr_migrants = (own->population_size / 20 > 0) ? own->population_size / 20 : 1;
+
+	for (int s = 1; s < nr_islands; s++) {
+		if (topology == MIGRATION_RING && s > 1)
+			break;
+
+		source = (island_id + nr_islands - s) % nr_islands;
+		count = (topology == MIGRATION_RING) ? nr_migrants : nr_migrants / (nr_islands - 1);
+		if (count == 0)
+			count = 1;
+		// only the elite children are known to be the best
+		if (count > islands[source].population_size * 3 / 10)
+			count = islands[source].population_size * 3 / 10;
+
+		for (int r = 0; r < count && slot >= cursor; r++, slot--) {
+			make_writable(&own->chromosomes, own->published + slot);
+			copy_individual(islands[source].published + r, own->published + slot);
+		}
+	}
+
+	return slot;
+}
+
+// the leader of the first island of a worker process posts the best
+// individuals of the island for the other workers and takes theirs (the
+// ring takes the migrants of the previous worker, all to all the ones
+// of every other worker), in the slots from slot down to cursor
+// buffer holds the migrants of a worker, last_sequences the versions
+// of the outboxes that were already taken
+void exchange_migrants(shared_islands *shared, int worker, island *isl, int topology,
+	int nr_migrants, int slot, int generation, char *buffer, uint64_t *last_sequences)
+{
+	int cursor = isl->population_size * 3 / 10 + 2 * (isl->population_size * 2 / 10);
+	int nr_workers = shared->nr_workers;
+	int source, count;
+	shared_migrant *migrant;
+	individual *to;
+
+	if (nr_migrants == 0 || nr_migrants > shared->capacity)
+		nr_migrants = shared->capacity;
+
+	count = nr_migrants;
+	if (count > isl->population_size * 3 / 10)
+		count = isl->population_size * 3 / 10;
+	post_migrants(shared, worker, isl->published, count, generation);
+
+	for (int s = 1; s < nr_workers; s++) {
+		if (topology == MIGRATION_RING && s > 1)
+			break;
+
+		source = (worker + nr_workers - s) % nr_workers;
+		count = (topology == MIGRATION_RING) ? nr_migrants : nr_migrants / (nr_workers - 1);
+		if (count == 0)
+			count = 1;
+		count = fetch_migrants(shared, source, buffer, count, &last_sequences[source]);
+
+		for (int r = 0; r < count && slot >= cursor; r++, slot--) {
+			migrant = (shared_migrant *) (buffer + r * shared->migrant_size);
+			to = isl->published + slot;
+			make_writable(&isl->chromosomes, to);
+			memcpy(to->chromosomes, migrant->chromosomes, shared->nr_words * sizeof(uint64_t));
+			to->weight = migrant->weight;
+			to->profit = migrant->profit;
+			to->count = migrant->count;
+		}
+	}
+}
+
+// the best fitness over all the islands
+int islands_best_fitness(const island *islands, int nr_islands)
+{
+	int best = islands[0].best_fitness;
+
+	for (int i = 1; i < nr_islands; i++) {
+		if (islands[i].best_fitness > best)
+			best = islands[i].best_fitness;
+	}
+	return best;
+}
+
+// the island with the best fitness (the first one on ties)
+island *best_island(island *islands, int nr_islands)
+{
+	island *best = &islands[0];
 
-		pthread_barrier_wait(barrier);
+	for (int i = 1; i < nr_islands; i++) {
+		if (islands[i].best_fitness > best->best_fitness)
+			best = &islands[i];
+	}
+	return best;
+}
+
+// sorts the generation with the method chosen on the command line
+// with SORT_TOPK only the first info_ms->top individuals and the
+// last one are in their sorted positions, which is all that
+// the reproduction step reads
+void sort_generation_parallel(info *info_ms)
+{
+	if (info_ms->sort_mode == SORT_TOPK) {
+		select_top_parallel(info_ms->v, info_ms->v_prev, info_ms->actual_length, info_ms->top,
+			info_ms->selection, info_ms->id, info_ms->nr_threads, info_ms->barrier);
+	} else if (info_ms->sort_mode == SORT_RADIX) {
+		radix_sort_parallel(info_ms->v, info_ms->v_prev, info_ms->actual_length,
+			info_ms->selection, info_ms->id, info_ms->nr_threads, info_ms->barrier);
+	} else {
+		mergesort_parallel(info_ms);
 	}
 }
 
@@ -362,80 +1098,98 @@ void run_parallel_algorithm(generation_info *gen_info)
 	int nr_threads = gen_info->nr_threads;
 	int id = gen_info->index;
 
-	// get the number of objects
+	// get the number of objects and of individuals
 	int nr_objects = *gen_info->nr_objects;
+	int population_size = gen_info->population_size;
+	int first_individual = gen_info->first_individual;
+	island *own_island = &gen_info->islands[gen_info->island_id];
+	const ga_options *opts = gen_info->opts;
+	shared_islands *shared = opts->shared;
+	int slot, stopped_at;
 	int nr_generations = *gen_info->nr_generations;
 
 	// get the objects and sack capacity
 	int sack_capacity = gen_info->capacity;
-	sack_object *objects = gen_info->objects;
+	object_table *table = gen_info->table;
+
+	if (gen_info->gate != NULL && !pass_start_gate(gen_info->gate))
+		return;
+
+	// a pinned thread moves to its cpu before it touches its slice
+	if (gen_info->cpu >= 0 && !pin_thread(gen_info->cpu))
+		fprintf(stderr, "Thread-ul %d nu a putut fi fixat pe cpu %d\n", gen_info->global_index,
+			gen_info->cpu);
 
 	// compute the start and end index using the id of the thread
-	int end;
-	int start = id * (double) nr_objects / nr_threads;
-	if ((id + 1) * (double) nr_objects / nr_threads > nr_objects)
-		end = nr_objects;
-	else
-		end = (id + 1) * (double) nr_objects / nr_threads;
+	int start = slice_bound(id, population_size, nr_threads, gen_info->slice_align);
+	int end = slice_bound(id + 1, population_size, nr_threads, gen_info->slice_align);
 
 	// get the barrier
-	pthread_barrier_t *barrier = gen_info->barrier;
+	thread_barrier *barrier = gen_info->barrier;
 	// get the generations
 	individual *current_generation = gen_info->current_generation;
 	individual *next_generation = gen_info->next_generation;
 
+	PROFILE_THREAD_START(gen_info->global_index);
+	PROFILE_BEGIN(PHASE_INIT);
+
 	// init the current generation and the next generation
+	// every thread first touches its own slice of the two arenas,
+	// so the pages land on its numa node
+	first_touch_arena(gen_info->current_arena, start, end);
+	first_touch_arena(gen_info->next_arena, start, end);
 	for (int i = start; i < end; i++) {
 		current_generation[i].fitness = 0;
-		current_generation[i].chromosomes = (int*) calloc(nr_objects, sizeof(int));
-		current_generation[i].chromosomes[i] = 1;
+		current_generation[i].chromosomes = arena_chromosomes(gen_info->current_arena, i);
+		current_generation[i].handle = i;
 		current_generation[i].index = i;
 		current_generation[i].chromosome_length = nr_objects;
 		
 		next_generation[i].fitness = 0;
-		next_generation[i].chromosomes = (int*) calloc(nr_objects, sizeof(int));
+		next_generation[i].chromosomes = NULL;
+		next_generation[i].handle = -1;
 		next_generation[i].index = i;
 		next_generation[i].chromosome_length = nr_objects;
 	}
-	pthread_barrier_wait(barrier);
-
-	int count, cursor;
-	individual *tmp = NULL;	
-
-	int start_sel, end_sel;
-	int start_mut1, end_mut1;
-	int start_mut2, end_mut2;
-
-	// compute start and end indexes for the children selection
-	int count1 = nr_objects * 3 / 10;
-	start_sel = id * (double) count1 / nr_threads;
-	if ((id + 1) * (double) count1 / nr_threads > count1)
-		end_sel = count1;
-	else
-		end_sel = (id + 1) * (double) count1 / nr_threads;
-
-	int count2 = nr_objects * 2 / 10;
- 	// compute the start and the end for this computation
-	// depending on the value of count
-	start_mut1 = id * (double) count2 / nr_threads;
-	if ((id + 1) * (double) count2 / nr_threads > count2)
-		end_mut1 = count2;
-	else
-		end_mut1 = (id + 1) * (double) count2 / nr_threads;
+	// a resumed run takes the generation from the checkpoint
+	if (gen_info->resume != NULL) {
+		restore_checkpoint_slice(gen_info->resume, current_generation, next_generation,
+			own_island->first_individual, start, end);
+	} else {
+		for (int i = start; i < end; i++) {
+			seed_individual(current_generation + i, first_individual + i, gen_info->total_population, nr_objects);
+			evaluate_individual(current_generation + i, table);
+			if (opts->seeding != SEEDING_SINGLE)
+				greedy_seed_individual(current_generation + i, first_individual + i, table,
+					gen_info->ratio_order, sack_capacity, opts->seeding, opts->random_seed);
+		}
+	}
+	wait_barrier(barrier, id);
+	PROFILE_END();
 
-	start_mut2 = start_mut1 + count2;
-	end_mut2 = end_mut1 + count2;
+	individual *tmp = NULL;
+	int count1 = population_size * 3 / 10;
+	int count2 = population_size * 2 / 10;
+	int nr_parents = population_size - count1 - 2 * count2;
 
 	// create the structure used as argument for the sort function
 	// (it helps each thread with the data accessible)
 	info *info_ms;
 	info_ms = malloc(sizeof(info));
 	info_ms->id = id;
-	info_ms->count = nr_objects;
+	info_ms->count = population_size;
 	info_ms->barrier = barrier;
-	info_ms->square_length = gen_info->square_length;
-	info_ms->actual_length = nr_objects;
+	info_ms->actual_length = population_size;
 	info_ms->nr_threads = nr_threads;
+	info_ms->sort_mode = gen_info->sort_mode;
+	info_ms->selection = gen_info->selection;
+	info_ms->pool = gen_info->pool;
+	// the elites are the first 30%, the crossover parents the first
+	// nr_parents (about 30%), the sources of the two mutations the
+	// first 40% and the index of the individuals ranked between 30%
+	// and 50% decides how their slots are mutated in the next
+	// generation, so the first 50% must be in order
+	info_ms->top = (nr_parents > count1 + count2) ? nr_parents : count1 + count2;
 
 	individual *prev_generation = gen_info->prev_generation;
 	
@@ -443,59 +1197,99 @@ void run_parallel_algorithm(generation_info *gen_info)
 	info_ms->v_prev = &prev_generation;
 
 	// iterate to construct the generations
-	for (int k = 0; k < nr_generations; k++) {
-		cursor = 0;
-
-		// compute the fitness
-		compute_fitness_function_parallel(objects, current_generation, nr_objects, sack_capacity, id, nr_threads);
-		
-		// perform the sort
-		pthread_barrier_wait(barrier);
-		mergesort_parallel(info_ms);
-		pthread_barrier_wait(barrier);
-		
-	 	// keep first 30% children (elite children selection)
-		for (int i = start_sel; i < end_sel; i++) {
-	 		copy_individual(current_generation + i, next_generation + i);
+	// every thread computes the fitness of its own slice, the sort
+	// waits for all the threads before reading the other slices and
+	// again before returning, so the only other barrier is the one
+	// that waits for all the children to be created
+	for (int k = gen_info->first_generation; k < nr_generations; k++) {
+		PROFILE_GENERATION(k);
+
+		// the state at the start of the generation is copied by all the
+		// threads and written in the background, unless the previous
+		// checkpoint is still being written (the decision is taken by
+		// one thread, once all the threads have read the previous one)
+		if (gen_info->checkpoint != NULL && k > gen_info->first_generation
+			&& k % opts->checkpoint_interval == 0) {
+			PROFILE_BEGIN(PHASE_CHECKPOINT);
+			wait_barrier(gen_info->global_barrier, gen_info->global_index);
+			if (gen_info->global_index == 0)
+				gen_info->checkpoint->take = !atomic_load(&gen_info->checkpoint->busy);
+			wait_barrier(gen_info->global_barrier, gen_info->global_index);
+			if (gen_info->checkpoint->take) {
+				save_checkpoint_slice(gen_info->checkpoint->buffer, current_generation, next_generation,
+					own_island->first_individual, start, end);
+				if (gen_info->global_index == 0) {
+					for (int j = 0; j < gen_info->nr_islands; j++)
+						checkpoint_islands(gen_info->checkpoint->buffer)[j] = gen_info->islands[j].best_fitness;
+				}
+				wait_barrier(gen_info->global_barrier, gen_info->global_index);
+				if (gen_info->global_index == 0)
+					request_checkpoint(gen_info->checkpoint, k, gen_info->stop);
+			}
+			PROFILE_END();
 		}
-	 	cursor = count1;
-		pthread_barrier_wait(barrier);
 
-		// mutate first 20% children with the first version of bit string mutation
-		for (int i = start_mut1; i < end_mut1; i++) {
-	 		copy_individual(current_generation + i, next_generation + cursor + i);
-	 		mutate_bit_string_1(next_generation + cursor + i, k);
+		// the islands exchange their best individuals (the only
+		// barriers of all the threads in the island mode), the first
+		// island of a worker process also with the other workers
+		if ((gen_info->nr_islands > 1 || shared != NULL) && k > 0
+			&& k % opts->migration_interval == 0) {
+			PROFILE_BEGIN(PHASE_MIGRATE);
+			if (id == 0)
+				own_island->published = current_generation;
+			wait_barrier(gen_info->global_barrier, gen_info->global_index);
+			if (id == 0) {
+				slot = migrate_island(gen_info->islands, gen_info->nr_islands, gen_info->island_id,
+					opts->migration_topology, opts->nr_migrants);
+				if (shared != NULL && gen_info->island_id == 0)
+					exchange_migrants(shared, opts->worker_id, own_island, opts->migration_topology,
+						opts->nr_migrants, slot, k, gen_info->migrant_buffer, gen_info->last_sequences);
+			}
+			if (gen_info->global_index == 0 && gen_info->logger != NULL)
+				log_progress(gen_info->logger, k, islands_best_fitness(gen_info->islands, gen_info->nr_islands));
+			// the islands are only in step here, so this is where
+			// they decide to stop, with the fitness of generation k - 1
+			if (gen_info->global_index == 0 && gen_info->stop != NULL && gen_info->nr_islands > 1)
+				check_stop_policy(gen_info->stop, islands_best_fitness(gen_info->islands,
+					gen_info->nr_islands), k - 1);
+			wait_barrier(gen_info->global_barrier, gen_info->global_index);
+			PROFILE_END();
+			if (gen_info->stop != NULL && gen_info->nr_islands > 1
+				&& atomic_load_explicit(&gen_info->stop->stop, memory_order_relaxed))
+				break;
 		}
-	 	cursor += count2;
-		pthread_barrier_wait(barrier);
 
-		// mutate next 20% children with the second version of bit string mutation
-		for (int i = start_mut2; i < end_mut2; i++) {
-			copy_individual(current_generation + i, next_generation + cursor + i - count2);
- 			mutate_bit_string_2(next_generation + cursor + i - count2, k);
-		}
-		cursor += count2;
-		pthread_barrier_wait(barrier);
-		
-	 	// crossover first 30% parents with one-point crossover
-		// (if there is an odd number of parents, the last one is kept as such)
-		count = nr_objects * 3 / 10;
-		if (count % 2 == 1 && id == 0) {
- 			copy_individual(current_generation + nr_objects - 1, next_generation + cursor + count - 1);
-			count--;
-		}
+		// compute the fitness
+		PROFILE_BEGIN(PHASE_FITNESS);
+		CHECK_TOTALS(table, current_generation, population_size, id, nr_threads, gen_info->slice_align);
+		compute_fitness_function_parallel(current_generation, population_size, sack_capacity, id, nr_threads,
+			gen_info->slice_align);
+		PROFILE_END();
 
-		// now I perform the crossover
-		pthread_barrier_wait(barrier);		
-	 	for (int i = start; i < end; i += 2) {
-			if (i < count)
-			{
-	 			crossover(current_generation + i, next_generation + cursor + i, k);
-			} else {
-				break;
-			}
+		// perform the sort
+		PROFILE_BEGIN(PHASE_SORT);
+		sort_generation_parallel(info_ms);
+		PROFILE_END();
+		if (id == 0)
+			own_island->best_fitness = current_generation[0].fitness;
+		// the flag is read after the barrier of the reproduction
+		if (gen_info->stop != NULL && gen_info->nr_islands == 1 && id == 0)
+			check_stop_policy(gen_info->stop, current_generation[0].fitness, k);
+
+		// create all the children in one pass
+		PROFILE_BEGIN(PHASE_REPRODUCE);
+		reproduce_parallel(current_generation, next_generation, population_size, k, table,
+			gen_info->chromosomes, gen_info->crossovers, opts->repair ? gen_info->ratio_order : NULL,
+			sack_capacity, gen_info->pool, id);
+		wait_barrier(barrier, id);
+		PROFILE_END();
+
+		// the parents drop their chromosomes, the buffers that are
+		// not used by any child become free for the next generation
+		PROFILE_BEGIN(PHASE_SWAP);
+		for (int i = start; i < end; ++i) {
+			release_chromosomes(gen_info->chromosomes, current_generation + i);
 		}
-		pthread_barrier_wait(barrier);
 
 		// switch to new generation
 		tmp = current_generation;
@@ -505,109 +1299,566 @@ void run_parallel_algorithm(generation_info *gen_info)
 		for (int i = start; i < end; ++i) {
 			current_generation[i].index = i;
 		}
-		pthread_barrier_wait(barrier);
-
-		// print the fitness
-		if (id == 0) {
+		PROFILE_END();
+
+		// print the fitness (through the logger)
+		// (from the thread that owns the first individual, which is
+		// not thread 0 when there are more threads than individuals,
+		// so that its fitness is not written while it is read)
+		// the islands only print when they migrate
+		if (gen_info->nr_islands == 1 && gen_info->logger != NULL && start == 0 && end > 0) {
 			if (k % 5 == 0) {
-				print_best_fitness(current_generation);
+				log_progress(gen_info->logger, k, current_generation[0].fitness);
 			}
 		}
+
+		if (gen_info->stop != NULL && gen_info->nr_islands == 1
+			&& atomic_load_explicit(&gen_info->stop->stop, memory_order_relaxed))
+			break;
     }
 
-	pthread_barrier_wait(barrier);
-	compute_fitness_function_parallel(objects, current_generation, nr_objects, sack_capacity, id, nr_threads);
-	// here I sort one last time and then I print the final result
-	// (the best firness)
-	pthread_barrier_wait(barrier);
-	mergesort_parallel(info_ms);
-	pthread_barrier_wait(barrier);
-	if (id == 0)
-		print_best_fitness(current_generation);
+	PROFILE_BEGIN(PHASE_FITNESS);
+	CHECK_TOTALS(table, current_generation, population_size, id, nr_threads, gen_info->slice_align);
+	compute_fitness_function_parallel(current_generation, population_size, sack_capacity, id, nr_threads,
+		gen_info->slice_align);
+	PROFILE_END();
+	// here I sort one last time and then I keep the final result
+	// (the best individual, printed by the caller)
+	// only the best individual is needed
+	info_ms->top = 1;
+	PROFILE_BEGIN(PHASE_SORT);
+	sort_generation_parallel(info_ms);
+	PROFILE_END();
+	stopped_at = gen_info->stop != NULL ? gen_info->stop->stopped_at : -1;
+	if (gen_info->nr_islands == 1) {
+		if (id == 0)
+			store_result(gen_info->result, current_generation, stopped_at);
+	} else {
+		if (id == 0) {
+			own_island->best_fitness = current_generation[0].fitness;
+			own_island->published = current_generation;
+		}
+		wait_barrier(gen_info->global_barrier, gen_info->global_index);
+		if (gen_info->global_index == 0)
+			store_result(gen_info->result, best_island(gen_info->islands, gen_info->nr_islands)->published,
+				stopped_at);
+	}
+
+	PROFILE_THREAD_STOP();
+	free(info_ms);
+}
+
+// also frees an island that was only partly allocated
+void free_island(island *isl)
+{
+	if (isl->nr_threads)
+		destroy_thread_barrier(&isl->barrier);
+
+	// free resources for old generation
+	if (isl->current_generation != NULL && isl->next_generation != NULL) {
+		free_generation(isl->current_generation, &isl->arenas[0]);
+		free_generation(isl->next_generation, &isl->arenas[1]);
+	}
+	free_population_arena(&isl->arenas[0]);
+	free_population_arena(&isl->arenas[1]);
+	free_chromosome_pool(&isl->chromosomes);
+
+	// free resources
+	unmap_individuals(isl->current_generation, isl->population_size * sizeof(individual));
+	unmap_individuals(isl->next_generation, isl->population_size * sizeof(individual));
+	unmap_individuals(isl->prev_generation, isl->population_size * sizeof(individual));
+	free_selection_state(&isl->selection);
+	free_work_pool(&isl->pool);
 }
 
-void run_genetic_algorithm(sack_object *objects, int nr_objects, int nr_gen, int capacity, int nr_threads)
+// allocates the generations, the chromosomes and the buffers of an island
+// (on failure, what was allocated is freed), returns GA_OK or the error
+int init_island(island *isl, int population_size, int nr_words, int nr_threads, int huge_pages,
+	int barrier_kind)
 {
+	memset(isl, 0, sizeof(island));
+	isl->population_size = population_size;
+
+	if (!init_thread_barrier(&isl->barrier, nr_threads, barrier_kind))
+		return GA_ERROR_THREADS;
+	isl->nr_threads = nr_threads;
+
+	// every thread writes first its own slice of the generations
+	isl->current_generation = map_individuals(population_size * sizeof(individual));
+	isl->next_generation = map_individuals(population_size * sizeof(individual));
+	isl->prev_generation = map_individuals(population_size * sizeof(individual));
+	if (isl->current_generation == NULL || isl->next_generation == NULL
+		|| isl->prev_generation == NULL) {
+		free_island(isl);
+		return GA_ERROR_MEMORY;
+	}
+
+	// one slab for the chromosomes of each generation buffer
+	if (!init_population_arena(&isl->arenas[0], population_size, nr_words, huge_pages)
+		|| !init_population_arena(&isl->arenas[1], population_size, nr_words, huge_pages)) {
+		free_island(isl);
+		return GA_ERROR_MEMORY;
+	}
+
+	// the buffers of the two arenas are shared by the individuals
+	// of both generations
+	if (!init_chromosome_pool(&isl->chromosomes, isl->arenas, population_size, nr_words)) {
+		free_island(isl);
+		return GA_ERROR_MEMORY;
+	}
+
+	// the deques from which the threads take (and steal) their work
+	if (!init_work_pool(&isl->pool, nr_threads)) {
+		free_island(isl);
+		return GA_ERROR_MEMORY;
+	}
+
+	// the buffers used by the partial sort
+	if (!init_selection_state(&isl->selection, population_size, nr_threads)) {
+		free_island(isl);
+		return GA_ERROR_MEMORY;
+	}
+
+	return GA_OK;
+}
+
+// the crossovers of all the islands, on stderr
+void print_crossover_stats(island *islands, int nr_islands)
+{
+	unsigned long long pairs = 0, hits = 0, misses = 0, false_matches = 0;
+
+	for (int j = 0; j < nr_islands; j++) {
+		pairs += atomic_load(&islands[j].crossovers.pairs);
+		hits += atomic_load(&islands[j].crossovers.hits);
+		misses += atomic_load(&islands[j].crossovers.misses);
+		false_matches += atomic_load(&islands[j].crossovers.false_matches);
+	}
+
+	fprintf(stderr, "incrucisari: %llu, parinti identici: %llu (%.1f%%), totaluri diferite: %llu, "
+		"totaluri egale cu gene diferite: %llu\n", pairs, hits, pairs ? 100.0 * hits / pairs : 0.0,
+		misses, false_matches);
+}
+
+// everything a run allocates besides its threads, freed by free_run
+// wherever init_run stopped
+typedef struct _ga_run {
+	island *islands;
+	int nr_islands;
+	thread_barrier barrier;
+	int barrier_ready;
+	char *migrant_buffer;
+	uint64_t *last_sequences;
+	char *resume;
+	size_t resume_size;
+	int first_generation;
+	checkpoint_writer checkpoint;
+	int checkpoint_ready;
+	stop_state stop;
+	progress_logger *logger;
+	int *ratio_order;
+	// the cpus of the threads, the calling thread getting back
+	// its own mask at the end
+	int *placement;
+	cpu_mask saved_mask;
+	int mask_saved;
+} ga_run;
+
+void free_run(ga_run *run)
+{
+	if (run->logger != NULL) {
+		stop_progress_logger(run->logger);
+		free(run->logger);
+	}
+	if (run->checkpoint_ready)
+		stop_checkpoint_writer(&run->checkpoint);
+	if (run->resume != NULL)
+		munmap(run->resume, run->resume_size);
+	if (run->barrier_ready)
+		destroy_thread_barrier(&run->barrier);
+
+	for (int j = 0; j < run->nr_islands; j++) {
+		free_island(&run->islands[j]);
+	}
+	free(run->islands);
+	free(run->migrant_buffer);
+	free(run->last_sequences);
+	free(run->ratio_order);
+	free(run->placement);
+	if (run->mask_saved)
+		set_thread_affinity(&run->saved_mask);
+}
+
+// the cpus of the threads of a run (those of a worker process come
+// after the threads of the workers before it), printed unless quiet;
+// returns GA_OK or the error
+int init_placement(ga_run *run, int nr_threads, const ga_options *opts)
+{
+	int first_thread = opts->worker_id * nr_threads;
+	int list[AFFINITY_MAX_CPUS];
+	int list_length = 0;
+	cpu_topology *topology = malloc(sizeof(cpu_topology));
+
+	run->placement = malloc(nr_threads * sizeof(int));
+	if (topology == NULL || run->placement == NULL) {
+		free(topology);
+		return GA_ERROR_MEMORY;
+	}
+
+	run->mask_saved = get_thread_affinity(&run->saved_mask);
+	if (!run->mask_saved || !detect_topology(topology)) {
+		free(topology);
+		return GA_ERROR_TOPOLOGY;
+	}
+
+	if (opts->affinity == AFFINITY_LIST)
+		list_length = parse_cpu_list(opts->affinity_list, list, AFFINITY_MAX_CPUS);
+	if (!place_threads(topology, opts->affinity, list, list_length, first_thread, nr_threads,
+		run->placement)) {
+		free(topology);
+		return opts->affinity == AFFINITY_LIST ? GA_ERROR_CPUS : GA_ERROR_MEMORY;
+	}
+
+	if (!opts->quiet)
+		print_placement(stderr, topology, opts->affinity, first_thread, nr_threads, run->placement);
+	free(topology);
+
+	return GA_OK;
+}
+
+// allocates everything a run needs (on failure, what was allocated
+// is freed), returns GA_OK or the error
+int init_run(ga_run *run, object_table *table, int capacity, int nr_threads, int population_size,
+	const ga_options *opts)
+{
+	int nr_islands = opts->nr_islands;
+	int nr_objects = table->nr_objects;
+	int error;
+
+	memset(run, 0, sizeof(ga_run));
+
+	// every island needs at least one thread and one individual
+	if (nr_islands > nr_threads || nr_islands > population_size)
+		return GA_ERROR_ISLANDS;
+
+	//create the barrier of all the threads, used only by the islands
+	if (!init_thread_barrier(&run->barrier, nr_threads, opts->barrier))
+		return GA_ERROR_THREADS;
+	run->barrier_ready = 1;
+
+	// the population and the threads are split evenly between the islands
+	run->islands = aligned_alloc(64, nr_islands * sizeof(island));
+	if (run->islands == NULL) {
+		free_run(run);
+		return GA_ERROR_MEMORY;
+	}
+	for (int j = 0; j < nr_islands; j++) {
+		int first_individual = (long long) j * population_size / nr_islands;
+		int first_thread = j * nr_threads / nr_islands;
+
+		error = init_island(&run->islands[j], (long long) (j + 1) * population_size / nr_islands - first_individual,
+			chromosome_words(nr_objects), (j + 1) * nr_threads / nr_islands - first_thread,
+			opts->huge_pages, opts->barrier);
+		if (error != GA_OK) {
+			free_run(run);
+			return error;
+		}
+		run->islands[j].first_individual = first_individual;
+		run->islands[j].first_thread = first_thread;
+		run->nr_islands++;
+	}
+
+	// a worker process keeps a buffer for the migrants of the others
+	if (opts->shared != NULL) {
+		run->migrant_buffer = malloc(opts->shared->outbox_size);
+		run->last_sequences = calloc(opts->shared->nr_workers, sizeof(uint64_t));
+		if (run->migrant_buffer == NULL || run->last_sequences == NULL) {
+			free_run(run);
+			return GA_ERROR_MEMORY;
+		}
+	}
+
+	// the checkpoint to resume from must be of the same instance
+	// and of the same population, split in the same islands
+	if (opts->resume_path != NULL) {
+		run->resume = map_checkpoint(opts->resume_path, table, capacity, population_size, nr_islands,
+			&run->resume_size);
+		if (run->resume == NULL) {
+			free_run(run);
+			return GA_ERROR_RESUME;
+		}
+		run->first_generation = ((checkpoint_header *) run->resume)->generation;
+		for (int j = 0; j < nr_islands; j++)
+			run->islands[j].best_fitness = checkpoint_islands(run->resume)[j];
+	}
+
+	if (opts->checkpoint_path != NULL) {
+		if (!start_checkpoint_writer(&run->checkpoint, opts->checkpoint_path, table, capacity,
+			population_size, nr_islands)) {
+			free_run(run);
+			return GA_ERROR_CHECKPOINT;
+		}
+		run->checkpoint_ready = 1;
+	}
+
+	// the policy is checked by the first thread, the workers of
+	// run_workers each stop on their own
+	init_stop_state(&run->stop, &opts->stop, run->first_generation);
+	if (run->resume != NULL)
+		restore_checkpoint_stop(run->resume, &run->stop);
+
+	// the objects by ratio, for the greedy operators
+	if (opts->repair || opts->seeding != SEEDING_SINGLE) {
+		run->ratio_order = init_ratio_order(table);
+		if (run->ratio_order == NULL) {
+			free_run(run);
+			return GA_ERROR_MEMORY;
+		}
+	}
+
+	if (opts->affinity != AFFINITY_NONE) {
+		error = init_placement(run, nr_threads, opts);
+		if (error != GA_OK) {
+			free_run(run);
+			return error;
+		}
+	}
+
+	// the progress of the workers is not printed
+	if (!opts->quiet && opts->shared == NULL) {
+		run->logger = aligned_alloc(64, sizeof(progress_logger));
+		if (run->logger == NULL || !start_progress_logger(run->logger, stdout, opts->log_format)) {
+			error = (run->logger == NULL) ? GA_ERROR_MEMORY : GA_ERROR_THREADS;
+			free(run->logger);
+			run->logger = NULL;
+			free_run(run);
+			return error;
+		}
+	}
+
+	return GA_OK;
+}
+
+// runs the generations and leaves the best individual in result
+// (nothing is printed besides the progress, unless opts->quiet)
+// the calling thread is the first thread of the algorithm
+// returns 0 if the run failed, the error being left in result
+// (nothing is left running and nothing is printed about it)
+int run_genetic_algorithm(object_table *table, int nr_gen, int capacity, int nr_threads,
+	const ga_options *opts, ga_result *result)
+{
+	int nr_objects = table->nr_objects;
+	int population_size = opts->population_size ? opts->population_size : nr_objects;
+	int nr_islands = opts->nr_islands;
+	uint64_t start_ns = monotonic_ns();
+	ga_run run;
+
     // declaring the threads that are going to be used in my algorithm
     pthread_t threads[nr_threads];
 
-    int err;
+    int err, created;
     int *nr_gen_aux, *nr_objects_aux;
+    start_gate gate;
     
     nr_gen_aux = &nr_gen;
     nr_objects_aux = &nr_objects;
 
-	//create the barrier
-	pthread_barrier_t barrier;
-	int err_barrier = pthread_barrier_init(&barrier, NULL, nr_threads);
-	if (err_barrier) {
-		printf("Eroare la initializarea barierei\n");
-		exit(-1);
+	memset(result, 0, sizeof(ga_result));
+	result->error = init_run(&run, table, capacity, nr_threads, population_size, opts);
+	if (result->error != GA_OK) {
+		return 0;
 	}
 
-	individual *current_generation, *next_generation;
-	current_generation = (individual*) calloc(nr_objects, sizeof(individual));
-	next_generation = (individual*) calloc(nr_objects, sizeof(individual));
+	// a worker process seeds its part of the population of all the workers
+	int nr_workers = opts->shared ? opts->shared->nr_workers : 1;
+	int worker_offset = opts->shared ? opts->worker_id * population_size : 0;
 
-	// let's change N now
-	int res_pow = 1, square_length;
-	int count_pow = 0;
-	while (res_pow < nr_objects) {
-		count_pow++;
-		res_pow = pow(2, count_pow);
+	if (!PROFILE_INIT(nr_threads, nr_gen)) {
+		free_run(&run);
+		result->error = GA_ERROR_MEMORY;
+		return 0;
 	}
-	square_length = res_pow;
-
-	individual *prev_generation = malloc(nr_objects * sizeof(individual));
 
 	// declare the array of structures passed as arguments to the parallel function
 	generation_info info[nr_threads];
 	// create the threads and the structure that is
 	// passed to each one of these threads
-    for (int i = 0; i < nr_threads; i++) {
-        info[i].index = i;
-        info[i].nr_generations = nr_gen_aux;
-        info[i].nr_objects = nr_objects_aux;
-		info[i].square_length = square_length;
-        info[i].objects = objects;
-        info[i].capacity = capacity;
-		info[i].nr_threads = nr_threads;
-		info[i].barrier = &barrier;
-		info[i].threads = threads;
-		info[i].current_generation = current_generation;
-		info[i].next_generation = next_generation;
-		info[i].prev_generation = prev_generation;
-    }
+	for (int j = 0; j < nr_islands; j++) {
+		island *isl = &run.islands[j];
+
+		// the fitness and the sort split the generation in the same slices
+		if (run.placement != NULL)
+			isl->selection.slice_align = slice_alignment(isl->population_size, isl->nr_threads,
+				&isl->arenas[0]);
+		for (int i = isl->first_thread; i < isl->first_thread + isl->nr_threads; i++) {
+			info[i].index = i - isl->first_thread;
+			info[i].global_index = i;
+			info[i].nr_generations = nr_gen_aux;
+			info[i].nr_objects = nr_objects_aux;
+			info[i].population_size = isl->population_size;
+			info[i].first_individual = worker_offset + isl->first_individual;
+			info[i].total_population = nr_workers * population_size;
+			info[i].pool = &isl->pool;
+			info[i].sort_mode = opts->sort_mode;
+			info[i].selection = &isl->selection;
+			info[i].table = table;
+			info[i].capacity = capacity;
+			info[i].nr_threads = isl->nr_threads;
+			info[i].barrier = &isl->barrier;
+			info[i].threads = threads;
+			info[i].current_generation = isl->current_generation;
+			info[i].next_generation = isl->next_generation;
+			info[i].prev_generation = isl->prev_generation;
+			info[i].current_arena = &isl->arenas[0];
+			info[i].next_arena = &isl->arenas[1];
+			info[i].chromosomes = &isl->chromosomes;
+			info[i].crossovers = &isl->crossovers;
+			info[i].islands = run.islands;
+			info[i].island_id = j;
+			info[i].nr_islands = nr_islands;
+			info[i].global_barrier = &run.barrier;
+			info[i].opts = opts;
+			info[i].migrant_buffer = run.migrant_buffer;
+			info[i].last_sequences = run.last_sequences;
+			info[i].checkpoint = run.checkpoint_ready ? &run.checkpoint : NULL;
+			info[i].resume = run.resume;
+			info[i].first_generation = run.first_generation;
+			info[i].stop = stop_policy_enabled(&opts->stop) ? &run.stop : NULL;
+			info[i].result = result;
+			info[i].logger = run.logger;
+			info[i].ratio_order = run.ratio_order;
+			info[i].cpu = run.placement ? run.placement[i] : -1;
+			info[i].slice_align = isl->selection.slice_align;
+			info[i].gate = (i == 0) ? NULL : &gate;
+		}
+	}
 
-	for (int i = 0; i < nr_threads; i++) {
-		err = pthread_create(&threads[i], NULL, (void *)run_parallel_algorithm, &info[i]);
-        if (err) {
-            printf("Error when creating the thread\n");
-            exit(-1);
-        }
+	// the calling thread runs the first slice, so a run with
+	// one thread does not create any; the others wait until all of
+	// them are created, so that if one of them cannot be, the others
+	// return before they wait for it at a barrier
+	init_start_gate(&gate);
+	for (created = 1; created < nr_threads; created++) {
+		err = pthread_create(&threads[created], NULL, (void *)run_parallel_algorithm, &info[created]);
+		if (err)
+			break;
 	}
+	if (created < nr_threads) {
+		release_start_gate(&gate, GATE_CLOSED);
+		for (int i = 1; i < created; i++)
+			pthread_join(threads[i], NULL);
+		destroy_start_gate(&gate);
+		PROFILE_FREE();
+		free_run(&run);
+		result->error = GA_ERROR_THREADS;
+		return 0;
+	}
+	release_start_gate(&gate, GATE_OPEN);
+	run_parallel_algorithm(&info[0]);
 
 	// joining the threads when the algorithm is completed
-    for (int i = 0; i < nr_threads; i++) {
-		int err = pthread_join(threads[i], NULL);
-
-		if (err) {
-	  		printf("Eroare la asteptarea thread-ului %d\n", i);
-	  		exit(-1);
-		}
+    for (int i = 1; i < nr_threads; i++) {
+		if (pthread_join(threads[i], NULL))
+			result->error = GA_ERROR_THREADS;
   	}
+	destroy_start_gate(&gate);
 
-	pthread_barrier_destroy(&barrier);
+	PROFILE_REPORT();
 
-	// free resources for old generation
-	free_generation(current_generation);
-	free_generation(next_generation);
+	if (opts->crossover_stats)
+		print_crossover_stats(run.islands, nr_islands);
 
-	// free resources
-	free(current_generation);
-	free(next_generation);
+	free_run(&run);
+	result->elapsed_ns = monotonic_ns() - start_ns;
+
+	if (result->error == GA_OK && result->genes == NULL)
+		result->error = GA_ERROR_MEMORY;
+	if (result->error != GA_OK) {
+		ga_free_result(result);
+		return 0;
+	}
+	return 1;
+}
+
+// the coordinator of the worker processes: every worker runs the whole
+// algorithm (with its threads and its islands) on its own population and
+// they exchange migrants through shared memory; a worker that fails
+// does not stop the others, the best fitness of the workers that
+// finished is the result (without the genes of the individual, which
+// stay in the worker)
+// returns 0 if no worker finished
+int run_workers(object_table *table, int nr_gen, int capacity, int nr_threads,
+	ga_options *opts, ga_result *result)
+{
+	int nr_workers = opts->nr_processes;
+	int population_size = opts->population_size ? opts->population_size : table->nr_objects;
+	int nr_migrants = opts->nr_migrants;
+	int best = -1, status;
+	pid_t pids[nr_workers];
+	shared_islands shared;
+	ga_result own;
+	uint64_t start_ns = monotonic_ns();
+
+	memset(result, 0, sizeof(ga_result));
+
+	// the outboxes hold the migrants of the first island of a worker
+	if (nr_migrants == 0) {
+		nr_migrants = population_size / opts->nr_islands / 20;
+		if (nr_migrants == 0)
+			nr_migrants = 1;
+	}
+
+	if (!create_shared_islands(&shared, nr_workers, chromosome_words(table->nr_objects), nr_migrants)) {
+		result->error = GA_ERROR_PROCESSES;
+		return 0;
+	}
+
+	fflush(stdout);
+	for (int w = 0; w < nr_workers; w++) {
+		pids[w] = fork();
+		// the workers already forked would wait for the migrants of the
+		// missing one, so they are stopped and the segment is removed
+		if (pids[w] < 0) {
+			for (int i = 0; i < w; i++) {
+				kill(pids[i], SIGKILL);
+				waitpid(pids[i], &status, 0);
+			}
+			destroy_shared_islands(&shared);
+			result->error = GA_ERROR_PROCESSES;
+			return 0;
+		}
+		// a worker leaves its result to the coordinator
+		if (pids[w] == 0) {
+			opts->worker_id = w;
+			opts->shared = &shared;
+			if (!run_genetic_algorithm(table, nr_gen, capacity, nr_threads, opts, &own)) {
+				print_run_error(&own, opts);
+				exit(-1);
+			}
+			atomic_store(&shared.slots[w].best_fitness, own.best_fitness);
+			atomic_store(&shared.slots[w].done, 1);
+			exit(0);
+		}
+	}
+
+	for (int w = 0; w < nr_workers; w++) {
+		if (waitpid(pids[w], &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0
+			|| !atomic_load(&shared.slots[w].done)) {
+			fprintf(stderr, "Procesul %d a esuat\n", w);
+			continue;
+		}
+		if (atomic_load(&shared.slots[w].best_fitness) > best)
+			best = atomic_load(&shared.slots[w].best_fitness);
+	}
+
+	destroy_shared_islands(&shared);
 
-    pthread_exit(NULL);
+	result->best_fitness = best;
+	result->stopped_at = -1;
+	result->nr_objects = table->nr_objects;
+	result->elapsed_ns = monotonic_ns() - start_ns;
+	if (best < 0)
+		result->error = GA_ERROR_PROCESSES;
+	return best >= 0;
 }
 
 #endif
@@ -0,0 +1,58 @@
+#ifndef INDIVIDUAL_H
+#define INDIVIDUAL_H
+
+#include <stdint.h>
+
+// structure for an individual in the genetic algorithm
+// the chromosomes are a bit string corresponding to each sack
+// object, in order, where 1 means that the object is in
+// the sack, 0 that it is not
+
+// the bits are packed 64 per word (gene j is bit j % 64 of
+// word j / 64) and the unused bits of the last word are always 0
+
+// I added the count member so that I can keep track of the
+// non-zero chromosomes
+
+// the weight and the profit members hold the totals of the objects
+// in the sack; they are updated by every operator that changes the
+// chromosomes, so the fitness never needs a full scan of them
+
+// the chromosomes are a buffer of the chromosome pool, which can be
+// shared with other individuals, handle being its number in the pool
+typedef struct _individual {
+	int fitness;
+	uint64_t *chromosomes;
+    int chromosome_length;
+	int index;
+	int count;
+	int weight;
+	int profit;
+	int handle;
+} individual;
+
+// number of 64 bit words needed for a chromosome of the given length
+static inline int chromosome_words(int chromosome_length)
+{
+	return (chromosome_length + 63) / 64;
+}
+
+// returns the value (0 or 1) of the gene on position j
+static inline int get_gene(const uint64_t *chromosomes, int j)
+{
+	return (chromosomes[j >> 6] >> (j & 63)) & 1;
+}
+
+// sets the gene on position j to 1
+static inline void set_gene(uint64_t *chromosomes, int j)
+{
+	chromosomes[j >> 6] |= 1ULL << (j & 63);
+}
+
+// flips the gene on position j
+static inline void flip_gene(uint64_t *chromosomes, int j)
+{
+	chromosomes[j >> 6] ^= 1ULL << (j & 63);
+}
+
+#endif
@@ -0,0 +1,315 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "fitness.h"
+#include "barrier.h"
+
+// a binary instance starts with a header of 64 bytes, followed by
+// the weights and then by the profits, each array padded with zeros
+// to nr_padded objects, so that the file can be mapped and used
+// directly as the arrays of the object table (both stay 64 byte
+// aligned, the mapping being page aligned)
+#define INSTANCE_MAGIC "GAKNAP01"
+#define INSTANCE_HEADER_SIZE 64
+
+typedef struct _instance_header {
+	char magic[8];
+	int32_t nr_objects;
+	int32_t capacity;
+	int32_t nr_padded;
+	char reserved[INSTANCE_HEADER_SIZE - 20];
+} instance_header;
+
+// text files smaller than this are parsed by a single thread
+#define PARALLEL_PARSE_MIN_SIZE (1 << 20)
+
+static inline int is_blank(char c)
+{
+	return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// parses the integer that starts at p (the file is not null terminated,
+// so strtol can not be used), returns the position after it or NULL
+const char *parse_int(const char *p, const char *end, int *value)
+{
+	long long number = 0;
+	int negative = 0;
+
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = (*p == '-');
+		p++;
+	}
+	if (p >= end || *p < '0' || *p > '9')
+		return NULL;
+
+	while (p < end && *p >= '0' && *p <= '9') {
+		number = number * 10 + (*p - '0');
+		if (number > (long long) INT_MAX + 1)
+			return NULL;
+		p++;
+	}
+	if (p < end && !is_blank(*p))
+		return NULL;
+
+	number = negative ? -number : number;
+	if (number > INT_MAX)
+		return NULL;
+
+	*value = (int) number;
+	return p;
+}
+
+// the part of the text parsed by one thread: the tokens between
+// start and end, the first one having the index first_token
+typedef struct _parse_chunk {
+	const char *start;
+	const char *end;
+	int nr_tokens;
+	int first_token;
+	int error;
+} parse_chunk;
+
+typedef struct _parse_args {
+	parse_chunk *chunks;
+	int id;
+	int nr_threads;
+	object_table *table;
+	pthread_barrier_t *barrier;
+	start_gate *gate;
+} parse_args;
+
+// every thread counts the tokens of its chunk, then, once the
+// index of its first token is known, parses them into the table;
+// token t is the profit (t even) or the weight (t odd) of object t / 2
+void *parse_chunk_parallel(void *arg)
+{
+	parse_args *args = (parse_args *) arg;
+	parse_chunk *chunk = &args->chunks[args->id];
+	int nr_values = 2 * args->table->nr_objects;
+	const char *p = chunk->start;
+	int token, value;
+
+	if (args->nr_threads > 1 && !pass_start_gate(args->gate))
+		return NULL;
+
+	chunk->nr_tokens = 0;
+	while (p < chunk->end) {
+		if (is_blank(*p)) {
+			p++;
+			continue;
+		}
+		chunk->nr_tokens++;
+		while (p < chunk->end && !is_blank(*p))
+			p++;
+	}
+
+	if (args->nr_threads > 1)
+		pthread_barrier_wait(args->barrier);
+
+	token = 0;
+	for (int t = 0; t < args->id; t++)
+		token += args->chunks[t].nr_tokens;
+	chunk->first_token = token;
+
+	// the tokens after the first 2 * N values are ignored
+	p = chunk->start;
+	while (p < chunk->end && token < nr_values) {
+		if (is_blank(*p)) {
+			p++;
+			continue;
+		}
+		p = parse_int(p, chunk->end, &value);
+		if (p == NULL) {
+			chunk->error = 1;
+			return NULL;
+		}
+		if (token % 2 == 0)
+			args->table->profits[token / 2] = value;
+		else
+			args->table->weights[token / 2] = value;
+		token++;
+	}
+
+	return NULL;
+}
+
+// parses the objects of a text instance, the file being split in
+// nr_threads chunks, each one cut at a blank character
+int parse_objects(const char *data, const char *end, object_table *table, int nr_threads)
+{
+	parse_chunk chunks[nr_threads];
+	parse_args args[nr_threads];
+	pthread_t threads[nr_threads];
+	pthread_barrier_t barrier;
+	start_gate gate;
+	size_t size = end - data;
+	int total = 0, created;
+
+	for (int t = 0; t < nr_threads; t++) {
+		chunks[t].start = (t == 0) ? data : chunks[t - 1].end;
+		chunks[t].end = (t == nr_threads - 1) ? end : data + (size_t) ((t + 1) * (double) size / nr_threads);
+		if (chunks[t].end < chunks[t].start)
+			chunks[t].end = chunks[t].start;
+		while (chunks[t].end < end && !is_blank(*chunks[t].end))
+			chunks[t].end++;
+		chunks[t].error = 0;
+
+		args[t].chunks = chunks;
+		args[t].id = t;
+		args[t].nr_threads = nr_threads;
+		args[t].table = table;
+		args[t].barrier = &barrier;
+		args[t].gate = &gate;
+	}
+
+	if (nr_threads == 1) {
+		parse_chunk_parallel(&args[0]);
+	} else {
+		if (pthread_barrier_init(&barrier, NULL, nr_threads))
+			return 0;
+		init_start_gate(&gate);
+		for (created = 0; created < nr_threads; created++) {
+			if (pthread_create(&threads[created], NULL, parse_chunk_parallel, &args[created]))
+				break;
+		}
+		// the threads start only once all of them exist
+		release_start_gate(&gate, created == nr_threads ? GATE_OPEN : GATE_CLOSED);
+		for (int t = 0; t < created; t++)
+			pthread_join(threads[t], NULL);
+		destroy_start_gate(&gate);
+		pthread_barrier_destroy(&barrier);
+		if (created < nr_threads)
+			return 0;
+	}
+
+	for (int t = 0; t < nr_threads; t++) {
+		if (chunks[t].error)
+			return 0;
+		total += chunks[t].nr_tokens;
+	}
+
+	return total >= 2 * table->nr_objects;
+}
+
+// the table points into the mapping of a binary instance
+int load_binary_instance(void *mapping, size_t size, object_table *table, int *capacity)
+{
+	instance_header header;
+
+	if (size < INSTANCE_HEADER_SIZE)
+		return 0;
+
+	memcpy(&header, mapping, sizeof(instance_header));
+	if (header.nr_objects <= 0 || header.nr_padded != padded_objects(header.nr_objects)
+		|| size < INSTANCE_HEADER_SIZE + 2 * (size_t) header.nr_padded * sizeof(int))
+		return 0;
+
+	memset(table, 0, sizeof(object_table));
+	table->nr_objects = header.nr_objects;
+	table->nr_padded = header.nr_padded;
+	table->weights = (int *) ((char *) mapping + INSTANCE_HEADER_SIZE);
+	table->profits = table->weights + header.nr_padded;
+	table->mapping = mapping;
+	table->mapping_size = size;
+	*capacity = header.capacity;
+
+	return finish_object_table(table);
+}
+
+// loads an instance, either a binary one (recognized by its magic)
+// or a text one, "N capacity" followed by N lines "profit weight"
+int load_instance(const char *path, object_table *table, int *capacity, int nr_threads)
+{
+	struct stat st;
+	const char *data, *p, *end;
+	void *mapping;
+	int fd, nr_objects;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return 0;
+
+	if (fstat(fd, &st) < 0 || st.st_size == 0) {
+		close(fd);
+		return 0;
+	}
+
+	mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED)
+		return 0;
+
+	if (st.st_size >= 8 && !memcmp(mapping, INSTANCE_MAGIC, 8)) {
+		if (!load_binary_instance(mapping, st.st_size, table, capacity)) {
+			munmap(mapping, st.st_size);
+			return 0;
+		}
+		return 1;
+	}
+
+	madvise(mapping, st.st_size, MADV_SEQUENTIAL);
+	data = mapping;
+	end = data + st.st_size;
+
+	// the two numbers of the header are parsed first
+	p = data;
+	while (p < end && is_blank(*p))
+		p++;
+	p = parse_int(p, end, &nr_objects);
+	while (p != NULL && p < end && is_blank(*p))
+		p++;
+	if (p != NULL)
+		p = parse_int(p, end, capacity);
+	if (p == NULL || nr_objects <= 0 || !alloc_object_table(table, nr_objects)) {
+		munmap(mapping, st.st_size);
+		return 0;
+	}
+
+	if (end - p < PARALLEL_PARSE_MIN_SIZE)
+		nr_threads = 1;
+
+	if (!parse_objects(p, end, table, nr_threads)) {
+		munmap(mapping, st.st_size);
+		free_object_table(table);
+		return 0;
+	}
+
+	munmap(mapping, st.st_size);
+	return finish_object_table(table);
+}
+
+// writes the table as a binary instance
+int save_binary_instance(const char *path, const object_table *table, int capacity)
+{
+	instance_header header;
+	FILE *fp;
+	int ok;
+
+	memset(&header, 0, sizeof(instance_header));
+	memcpy(header.magic, INSTANCE_MAGIC, 8);
+	header.nr_objects = table->nr_objects;
+	header.capacity = capacity;
+	header.nr_padded = table->nr_padded;
+
+	fp = fopen(path, "wb");
+	if (fp == NULL)
+		return 0;
+
+	ok = fwrite(&header, sizeof(instance_header), 1, fp) == 1
+		&& fwrite(table->weights, sizeof(int), table->nr_padded, fp) == (size_t) table->nr_padded
+		&& fwrite(table->profits, sizeof(int), table->nr_padded, fp) == (size_t) table->nr_padded;
+
+	return fclose(fp) == 0 && ok;
+}
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef ISA_H
+#define ISA_H
+
+#include <string.h>
+
+// the instruction sets for which the hot kernels are compiled: every
+// kernel has a variant for each of them in the same binary and the
+// variants that run are chosen once, at startup, from what the cpu
+// supports (or from --isa=)
+#define ISA_AUTO -1
+#define ISA_SCALAR 0
+#define ISA_AVX2 1
+#define ISA_AVX512 2
+#define NR_ISAS 3
+
+#define TARGET_AVX2 __attribute__((target("avx2,popcnt")))
+#define TARGET_AVX512 __attribute__((target("avx512f,popcnt")))
+
+const char *isa_name(int isa)
+{
+	static const char *names[] = {"scalar", "avx2", "avx512"};
+
+	return (isa >= 0 && isa < NR_ISAS) ? names[isa] : "auto";
+}
+
+// returns the instruction set with the given name, ISA_AUTO
+// for "auto" or -2 if there is none
+int parse_isa(const char *name)
+{
+	if (!strcmp(name, "auto"))
+		return ISA_AUTO;
+	for (int isa = 0; isa < NR_ISAS; isa++) {
+		if (!strcmp(name, isa_name(isa)))
+			return isa;
+	}
+	return -2;
+}
+
+int isa_supported(int isa)
+{
+	__builtin_cpu_init();
+
+	if (isa == ISA_AVX512)
+		return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("popcnt");
+	if (isa == ISA_AVX2)
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+	return isa == ISA_SCALAR;
+}
+
+// the best instruction set supported by the cpu
+int detect_isa(void)
+{
+	int isa = NR_ISAS - 1;
+
+	while (isa > ISA_SCALAR && !isa_supported(isa))
+		isa--;
+	return isa;
+}
+
+#endif
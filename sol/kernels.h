@@ -0,0 +1,193 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <immintrin.h>
+#include "isa.h"
+#include "fitness.h"
+
+// the kernels of the operators that work on whole chromosome words
+// (the mutation flips them, the crossover splices them and the copy
+// copies them), in one variant for every instruction set, like the
+// fitness kernels of fitness.h; select_kernels chooses the variants of
+// all of them at once
+// the sorts are not dispatched: their merges are bound by the
+// comparisons of the keys and have no vector variant
+
+typedef void (*complement_kernel_fn)(uint64_t *words, int count);
+typedef void (*copy_kernel_fn)(uint64_t *to, const uint64_t *from, int count);
+typedef void (*splice_kernel_fn)(uint64_t *child, const uint64_t *first,
+	const uint64_t *second, int count, int nr_words);
+
+// the cut of a splice: the first count genes come from the first
+// parent, the rest from the second one; the word in which the cut
+// is made takes bits from both parents
+static inline uint64_t splice_word(uint64_t first, uint64_t second, int count)
+{
+	uint64_t mask = (1ULL << (count & 63)) - 1;
+
+	return (first & mask) | (second & ~mask);
+}
+
+void complement_words_scalar(uint64_t *words, int count)
+{
+	for (int j = 0; j < count; j++) {
+		words[j] = ~words[j];
+	}
+}
+
+void copy_words_scalar(uint64_t *to, const uint64_t *from, int count)
+{
+	memcpy(to, from, count * sizeof(uint64_t));
+}
+
+void splice_chromosomes_scalar(uint64_t *child, const uint64_t *first,
+	const uint64_t *second, int count, int nr_words)
+{
+	int word = count >> 6;
+
+	memcpy(child, first, word * sizeof(uint64_t));
+	if (count & 63) {
+		child[word] = splice_word(first[word], second[word], count);
+		word++;
+	}
+	memcpy(child + word, second + word, (nr_words - word) * sizeof(uint64_t));
+}
+
+// AVX2 kernels, 4 words at a time, the last words one by one
+TARGET_AVX2
+void complement_words_avx2(uint64_t *words, int count)
+{
+	const __m256i ones = _mm256_set1_epi64x(-1);
+	int j = 0;
+
+	for (; j + 4 <= count; j += 4) {
+		_mm256_storeu_si256((__m256i *) (words + j), _mm256_xor_si256(ones,
+			_mm256_loadu_si256((const __m256i *) (words + j))));
+	}
+	for (; j < count; j++) {
+		words[j] = ~words[j];
+	}
+}
+
+TARGET_AVX2
+static inline void copy_words_avx2_inline(uint64_t *to, const uint64_t *from, int count)
+{
+	int j = 0;
+
+	for (; j + 4 <= count; j += 4) {
+		_mm256_storeu_si256((__m256i *) (to + j), _mm256_loadu_si256((const __m256i *) (from + j)));
+	}
+	for (; j < count; j++) {
+		to[j] = from[j];
+	}
+}
+
+TARGET_AVX2
+void copy_words_avx2(uint64_t *to, const uint64_t *from, int count)
+{
+	copy_words_avx2_inline(to, from, count);
+}
+
+TARGET_AVX2
+void splice_chromosomes_avx2(uint64_t *child, const uint64_t *first,
+	const uint64_t *second, int count, int nr_words)
+{
+	int word = count >> 6;
+
+	copy_words_avx2_inline(child, first, word);
+	if (count & 63) {
+		child[word] = splice_word(first[word], second[word], count);
+		word++;
+	}
+	copy_words_avx2_inline(child + word, second + word, nr_words - word);
+}
+
+// AVX-512 kernels, 8 words at a time, the last words with a mask
+TARGET_AVX512
+void complement_words_avx512(uint64_t *words, int count)
+{
+	const __m512i ones = _mm512_set1_epi64(-1);
+	__mmask8 mask;
+	int j = 0;
+
+	for (; j + 8 <= count; j += 8) {
+		_mm512_storeu_si512(words + j, _mm512_xor_si512(ones, _mm512_loadu_si512(words + j)));
+	}
+	if (j < count) {
+		mask = (__mmask8) ((1u << (count - j)) - 1);
+		_mm512_mask_storeu_epi64(words + j, mask, _mm512_xor_si512(ones,
+			_mm512_maskz_loadu_epi64(mask, words + j)));
+	}
+}
+
+TARGET_AVX512
+static inline void copy_words_avx512_inline(uint64_t *to, const uint64_t *from, int count)
+{
+	__mmask8 mask;
+	int j = 0;
+
+	for (; j + 8 <= count; j += 8) {
+		_mm512_storeu_si512(to + j, _mm512_loadu_si512(from + j));
+	}
+	if (j < count) {
+		mask = (__mmask8) ((1u << (count - j)) - 1);
+		_mm512_mask_storeu_epi64(to + j, mask, _mm512_maskz_loadu_epi64(mask, from + j));
+	}
+}
+
+TARGET_AVX512
+void copy_words_avx512(uint64_t *to, const uint64_t *from, int count)
+{
+	copy_words_avx512_inline(to, from, count);
+}
+
+TARGET_AVX512
+void splice_chromosomes_avx512(uint64_t *child, const uint64_t *first,
+	const uint64_t *second, int count, int nr_words)
+{
+	int word = count >> 6;
+
+	copy_words_avx512_inline(child, first, word);
+	if (count & 63) {
+		child[word] = splice_word(first[word], second[word], count);
+		word++;
+	}
+	copy_words_avx512_inline(child + word, second + word, nr_words - word);
+}
+
+// the kernels used by the algorithm, chosen once at startup
+complement_kernel_fn complement_kernel = complement_words_scalar;
+copy_kernel_fn copy_kernel = copy_words_scalar;
+splice_kernel_fn splice_kernel = splice_chromosomes_scalar;
+
+// chooses the variants of all the kernels for the given instruction
+// set (the best one supported by the cpu for ISA_AUTO), returns it
+// or -1 if the cpu does not support it
+int select_kernels(int isa)
+{
+	static const fitness_kernel_fn fitness_kernels[] = {fitness_kernel_scalar,
+		fitness_kernel_avx2, fitness_kernel_avx512};
+	static const complement_kernel_fn complement_kernels[] = {complement_words_scalar,
+		complement_words_avx2, complement_words_avx512};
+	static const copy_kernel_fn copy_kernels[] = {copy_words_scalar,
+		copy_words_avx2, copy_words_avx512};
+	static const splice_kernel_fn splice_kernels[] = {splice_chromosomes_scalar,
+		splice_chromosomes_avx2, splice_chromosomes_avx512};
+
+	if (isa == ISA_AUTO)
+		isa = detect_isa();
+	if (!isa_supported(isa))
+		return -1;
+
+	fitness_kernel = fitness_kernels[isa];
+	complement_kernel = complement_kernels[isa];
+	copy_kernel = copy_kernels[isa];
+	splice_kernel = splice_kernels[isa];
+
+	return isa;
+}
+
+#endif
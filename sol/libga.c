@@ -0,0 +1,209 @@
+#include "helpers.h"
+
+// libga, the interface of ga.h over the algorithm of helpers.h
+// (built with -fvisibility=hidden, so that only the functions of
+// ga.h are exported)
+
+// the settings of an engine, as the options of tema1_par
+struct _ga_engine {
+	ga_config config;
+	ga_options opts;
+};
+
+// the arguments of the tasks of a batch
+typedef struct _batch_args {
+	const ga_engine *engine;
+	const ga_instance *instances;
+	ga_result *results;
+	int nr_instances;
+	work_pool pool;
+	_Atomic int nr_solved;
+} batch_args;
+
+typedef struct _batch_thread {
+	batch_args *args;
+	int id;
+} batch_thread;
+
+// the kernels are chosen once, by the first engine, for the best
+// instruction set supported by the cpu
+static pthread_once_t kernel_once = PTHREAD_ONCE_INIT;
+
+static void init_kernels(void)
+{
+	select_kernels(ISA_AUTO);
+}
+
+void ga_default_config(ga_config *config)
+{
+	memset(config, 0, sizeof(ga_config));
+	config->nr_generations = 100;
+	config->nr_threads = 1;
+	config->sort_mode = GA_SORT_TOPK;
+	config->nr_islands = 1;
+	config->migration_interval = 10;
+	config->migration_topology = GA_MIGRATION_RING;
+	config->target = -1;
+	config->seeding = GA_SEEDING_SINGLE;
+	config->random_seed = 1;
+}
+
+ga_engine *ga_create(const ga_config *config)
+{
+	ga_engine *engine;
+
+	if (config->nr_generations <= 0 || config->nr_threads <= 0
+		|| config->sort_mode < GA_SORT_MERGE || config->sort_mode > GA_SORT_RADIX
+		|| config->population_size < 0 || config->nr_islands <= 0
+		|| config->nr_islands > config->nr_threads || config->migration_interval <= 0
+		|| (config->migration_topology != GA_MIGRATION_RING
+			&& config->migration_topology != GA_MIGRATION_ALL)
+		|| config->nr_migrants < 0 || config->stagnation < 0 || config->time_limit < 0
+		|| config->seeding < GA_SEEDING_SINGLE || config->seeding > GA_SEEDING_RANDOM) {
+		return NULL;
+	}
+
+	engine = malloc(sizeof(ga_engine));
+	if (engine == NULL)
+		return NULL;
+
+	engine->config = *config;
+	memset(&engine->opts, 0, sizeof(ga_options));
+	engine->opts.huge_pages = config->huge_pages;
+	engine->opts.sort_mode = config->sort_mode;
+	engine->opts.population_size = config->population_size;
+	engine->opts.nr_islands = config->nr_islands;
+	engine->opts.migration_interval = config->migration_interval;
+	engine->opts.migration_topology = config->migration_topology;
+	engine->opts.nr_migrants = config->nr_migrants;
+	engine->opts.nr_processes = 1;
+	engine->opts.stop.stagnation = config->stagnation;
+	engine->opts.stop.target = config->target;
+	engine->opts.stop.time_limit = config->time_limit;
+	engine->opts.repair = config->repair;
+	engine->opts.seeding = config->seeding;
+	engine->opts.random_seed = config->random_seed;
+	engine->opts.quiet = 1;
+
+	pthread_once(&kernel_once, init_kernels);
+
+	return engine;
+}
+
+void ga_destroy(ga_engine *engine)
+{
+	free(engine);
+}
+
+// the object table of an instance (the mutations need at least 3
+// objects), returns GA_OK or the error
+static int instance_table(const ga_instance *instance, object_table *table)
+{
+	if (instance->nr_objects < 3 || instance->capacity < 0)
+		return GA_ERROR_INSTANCE;
+
+	if (!alloc_object_table(table, instance->nr_objects))
+		return GA_ERROR_MEMORY;
+	memcpy(table->weights, instance->weights, instance->nr_objects * sizeof(int));
+	memcpy(table->profits, instance->profits, instance->nr_objects * sizeof(int));
+	if (!finish_object_table(table)) {
+		free_object_table(table);
+		return GA_ERROR_MEMORY;
+	}
+
+	return GA_OK;
+}
+
+static int solve_instance(const ga_engine *engine, const ga_options *opts, int nr_threads,
+	const ga_instance *instance, ga_result *result)
+{
+	object_table table;
+	int solved;
+
+	memset(result, 0, sizeof(ga_result));
+	result->error = instance_table(instance, &table);
+	if (result->error != GA_OK)
+		return 0;
+
+	solved = run_genetic_algorithm(&table, engine->config.nr_generations, instance->capacity,
+		nr_threads, opts, result);
+	free_object_table(&table);
+
+	return solved;
+}
+
+int ga_solve(ga_engine *engine, const ga_instance *instance, ga_result *result)
+{
+	return solve_instance(engine, &engine->opts, engine->config.nr_threads, instance, result);
+}
+
+// every instance of the batch is a task, solved by one thread
+// with a single island
+static void batch_task(void *arg, int start, int end)
+{
+	batch_args *args = arg;
+	ga_options opts = args->engine->opts;
+
+	opts.nr_islands = 1;
+	for (int i = start; i < end; i++) {
+		if (solve_instance(args->engine, &opts, 1, &args->instances[i], &args->results[i]))
+			atomic_fetch_add(&args->nr_solved, 1);
+	}
+}
+
+static void *batch_thread_fn(void *arg)
+{
+	batch_thread *thread = arg;
+
+	parallel_for(&thread->args->pool, thread->id, thread->args->nr_instances, batch_task, thread->args);
+	return NULL;
+}
+
+// the threads of the engine share the instances through a work pool,
+// a thread that is done with its own instances steals from the others,
+// so that the threads are created once for the whole batch
+int ga_solve_batch(ga_engine *engine, const ga_instance *instances, int nr_instances,
+	ga_result *results)
+{
+	int nr_threads = engine->config.nr_threads < nr_instances ? engine->config.nr_threads : nr_instances;
+	batch_thread threads[nr_threads > 0 ? nr_threads : 1];
+	pthread_t handles[nr_threads > 0 ? nr_threads : 1];
+	batch_args args;
+	int created;
+
+	if (nr_instances <= 0)
+		return 0;
+
+	args.engine = engine;
+	args.instances = instances;
+	args.results = results;
+	args.nr_instances = nr_instances;
+	atomic_init(&args.nr_solved, 0);
+	if (!init_work_pool(&args.pool, nr_threads))
+		return 0;
+
+	// the calling thread is the first thread of the batch
+	for (created = 1; created < nr_threads; created++) {
+		threads[created].args = &args;
+		threads[created].id = created;
+		if (pthread_create(&handles[created], NULL, batch_thread_fn, &threads[created]))
+			break;
+	}
+	// the calling thread also takes the place of the threads
+	// that could not be created
+	threads[0].args = &args;
+	threads[0].id = 0;
+	batch_thread_fn(&threads[0]);
+	for (int i = created; i < nr_threads; i++) {
+		threads[i].args = &args;
+		threads[i].id = i;
+		batch_thread_fn(&threads[i]);
+	}
+
+	for (int i = 1; i < created; i++) {
+		pthread_join(handles[i], NULL);
+	}
+	free_work_pool(&args.pool);
+
+	return atomic_load(&args.nr_solved);
+}
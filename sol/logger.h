@@ -0,0 +1,167 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "clock.h"
+
+// the progress of a run (the best fitness every few generations) is not
+// printed by the threads of the algorithm: the one thread that reports
+// it pushes a record in a ring, without any lock and without waiting,
+// and a logger thread of its own formats the records in a buffer, which
+// it writes when the ring is empty or when the buffer is full
+// if the output is so slow that the ring fills up, the new records are
+// dropped (and counted), the generations never wait for it
+
+// the formats of the records: the best fitness alone (as the skel
+// prints it), comma separated values or JSON lines
+#define LOG_TEXT 0
+#define LOG_CSV 1
+#define LOG_JSONL 2
+
+// a power of 2
+#define LOG_RING_SIZE 4096
+#define LOG_BUFFER_SIZE 65536
+// how long the logger sleeps when the ring is empty
+#define LOG_IDLE_NS 1000000
+
+typedef struct _progress_record {
+	int generation;
+	int best_fitness;
+	uint64_t ns;
+} progress_record;
+
+// the producer and the consumer each write their own index, on their
+// own cache line
+typedef struct _progress_logger {
+	progress_record records[LOG_RING_SIZE];
+	_Atomic uint64_t head __attribute__((aligned(64)));
+	_Atomic uint64_t tail __attribute__((aligned(64)));
+	_Atomic int stop __attribute__((aligned(64)));
+	uint64_t dropped;
+	int format;
+	int fd;
+	uint64_t start_ns;
+	pthread_t thread;
+	char buffer[LOG_BUFFER_SIZE];
+	size_t length;
+} progress_logger;
+
+// the header printed before the records (only CSV has one)
+void print_progress_header(FILE *fp, int format)
+{
+	if (format == LOG_CSV)
+		fprintf(fp, "generation,best_fitness,time_ns\n");
+}
+
+// formats a record, returns its length
+int format_progress_record(char *line, size_t size, int format, const progress_record *record)
+{
+	if (format == LOG_CSV)
+		return snprintf(line, size, "%d,%d,%llu\n", record->generation, record->best_fitness,
+			(unsigned long long) record->ns);
+	if (format == LOG_JSONL)
+		return snprintf(line, size, "{\"generation\":%d,\"best_fitness\":%d,\"time_ns\":%llu}\n",
+			record->generation, record->best_fitness, (unsigned long long) record->ns);
+	return snprintf(line, size, "%d\n", record->best_fitness);
+}
+
+static void flush_logger(progress_logger *logger)
+{
+	size_t done = 0;
+	ssize_t written;
+
+	while (done < logger->length) {
+		written = write(logger->fd, logger->buffer + done, logger->length - done);
+		if (written <= 0)
+			break;
+		done += written;
+	}
+	logger->length = 0;
+}
+
+void *logger_thread(void *arg)
+{
+	progress_logger *logger = arg;
+	struct timespec idle = {0, LOG_IDLE_NS};
+	uint64_t tail = atomic_load_explicit(&logger->tail, memory_order_relaxed);
+	uint64_t head;
+	char line[128];
+	int length, stop;
+
+	while (1) {
+		stop = atomic_load_explicit(&logger->stop, memory_order_acquire);
+		head = atomic_load_explicit(&logger->head, memory_order_acquire);
+
+		for (; tail < head; tail++) {
+			length = format_progress_record(line, sizeof(line), logger->format,
+				&logger->records[tail & (LOG_RING_SIZE - 1)]);
+			if (logger->length + length > LOG_BUFFER_SIZE)
+				flush_logger(logger);
+			memcpy(logger->buffer + logger->length, line, length);
+			logger->length += length;
+		}
+		atomic_store_explicit(&logger->tail, tail, memory_order_release);
+
+		// the ring is empty, what was formatted is written
+		flush_logger(logger);
+		if (stop)
+			break;
+		nanosleep(&idle, NULL);
+	}
+
+	return NULL;
+}
+
+// the records are written to fd (what is still buffered by stdio
+// in fp is written first, so that the order is kept)
+int start_progress_logger(progress_logger *logger, FILE *fp, int format)
+{
+	fflush(fp);
+	logger->fd = fileno(fp);
+	logger->format = format;
+	logger->length = 0;
+	logger->dropped = 0;
+	logger->start_ns = monotonic_ns();
+	atomic_init(&logger->head, 0);
+	atomic_init(&logger->tail, 0);
+	atomic_init(&logger->stop, 0);
+
+	return pthread_create(&logger->thread, NULL, logger_thread, logger) == 0;
+}
+
+// called by the single producer
+static inline void log_progress(progress_logger *logger, int generation, int best_fitness)
+{
+	uint64_t head = atomic_load_explicit(&logger->head, memory_order_relaxed);
+	progress_record *record;
+
+	if (head - atomic_load_explicit(&logger->tail, memory_order_acquire) == LOG_RING_SIZE) {
+		logger->dropped++;
+		return;
+	}
+
+	record = &logger->records[head & (LOG_RING_SIZE - 1)];
+	record->generation = generation;
+	record->best_fitness = best_fitness;
+	record->ns = monotonic_ns() - logger->start_ns;
+	atomic_store_explicit(&logger->head, head + 1, memory_order_release);
+}
+
+// writes the records that are left and stops the logger
+void stop_progress_logger(progress_logger *logger)
+{
+	atomic_store_explicit(&logger->stop, 1, memory_order_release);
+	pthread_join(logger->thread, NULL);
+
+	if (logger->dropped)
+		fprintf(stderr, "%llu inregistrari de progres nu au incaput in buffer\n",
+			(unsigned long long) logger->dropped);
+}
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef PHASES_H
+#define PHASES_H
+
+#include <stdio.h>
+
+// the phases of a generation seen by the instrumentation (profile.h
+// and trace.h), the steps of the mergesort being numbered by log2(width)
+#define PHASE_INIT 0
+#define PHASE_FITNESS 1
+#define PHASE_SORT 2
+#define PHASE_REPRODUCE 3
+#define PHASE_SWAP 4
+#define PHASE_MIGRATE 5
+#define PHASE_CHECKPOINT 6
+#define PHASE_MERGE_STEP 7
+#define MAX_MERGE_STEPS 31
+#define NR_PHASES (PHASE_MERGE_STEP + MAX_MERGE_STEPS)
+// the waits at the barriers, only traced (the profile adds
+// them to the phase in which they happen)
+#define PHASE_BARRIER NR_PHASES
+
+void phase_name(int phase, char *name, int size)
+{
+	static const char *names[] = {"init", "fitness", "sort", "reproduce", "swap", "migrate",
+		"checkpoint"};
+
+	if (phase < PHASE_MERGE_STEP)
+		snprintf(name, size, "%s", names[phase]);
+	else if (phase == PHASE_BARRIER)
+		snprintf(name, size, "barrier");
+	else
+		snprintf(name, size, "merge_w%llu", 1ULL << (phase - PHASE_MERGE_STEP));
+}
+
+#endif
@@ -0,0 +1,301 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "phases.h"
+#include "trace.h"
+#include "barrier.h"
+#include "clock.h"
+
+// instrumentation of the phases of a generation, compiled only with
+// -DPROFILE (make build_profile); without it the macros are empty and
+// wait_barrier only waits at the barrier
+// every thread records, for every phase, the wall time, the time spent
+// waiting at barriers inside the phase and, if perf_event_open works,
+// the cycles, the instructions and the last level cache misses
+// the phases nest (the steps of the mergesort are inside the sort), the
+// times of a phase include the ones of its inner phases, while the
+// barrier time goes to the innermost phase only
+// the same hooks also feed the timeline of trace.h (-DTRACE)
+
+#ifdef PROFILE
+
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+// the hardware counters read at the start and at the end of a phase
+#define NR_COUNTERS 3
+#define MAX_PHASE_DEPTH 8
+
+// the file in which the counters of every thread are dumped
+#define PROFILE_CSV "profile.csv"
+
+typedef struct _phase_counters {
+	uint64_t calls;
+	uint64_t wall_ns;
+	uint64_t barrier_ns;
+	uint64_t counters[NR_COUNTERS];
+} phase_counters;
+
+// the records of a thread, on their own cache lines
+typedef struct _thread_profile {
+	phase_counters phases[NR_PHASES];
+	int stack[MAX_PHASE_DEPTH];
+	uint64_t start_ns[MAX_PHASE_DEPTH];
+	uint64_t start_counters[MAX_PHASE_DEPTH][NR_COUNTERS];
+	int depth;
+	int perf_fd;
+} __attribute__((aligned(64))) thread_profile;
+
+thread_profile *profiles;
+int profile_threads;
+// set when at least one thread could not open the counters
+int profile_no_counters;
+__thread thread_profile *own_profile;
+
+// returns 0 if the records could not be allocated
+int profile_init(int nr_threads)
+{
+	profiles = aligned_alloc(64, nr_threads * sizeof(thread_profile));
+	if (profiles == NULL)
+		return 0;
+	memset(profiles, 0, nr_threads * sizeof(thread_profile));
+	profile_threads = nr_threads;
+	profile_no_counters = 0;
+	return 1;
+}
+
+void profile_free(void)
+{
+	free(profiles);
+	profiles = NULL;
+}
+
+// starts the profiling and the tracing of a run
+// returns 0 if their buffers could not be allocated
+int profile_start(int nr_threads, int nr_generations)
+{
+	if (!profile_init(nr_threads))
+		return 0;
+	if (!TRACE_INIT(nr_threads, nr_generations)) {
+		profile_free();
+		return 0;
+	}
+	return 1;
+}
+
+static int open_counter(uint32_t type, uint64_t config, int group)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.disabled = (group < 0);
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_GROUP;
+
+	return syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+// opens the counters of the calling thread, as a group read at once
+void profile_thread_start(int id)
+{
+	thread_profile *profile = &profiles[id];
+	int fd;
+
+	own_profile = profile;
+	profile->perf_fd = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1);
+	if (profile->perf_fd >= 0) {
+		fd = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, profile->perf_fd);
+		if (fd >= 0)
+			fd = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, profile->perf_fd);
+		if (fd < 0) {
+			close(profile->perf_fd);
+			profile->perf_fd = -1;
+		}
+	}
+
+	if (profile->perf_fd < 0) {
+		profile_no_counters = 1;
+		return;
+	}
+	ioctl(profile->perf_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+	ioctl(profile->perf_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+// closing the leader of the group closes the whole group
+void profile_thread_stop(void)
+{
+	if (own_profile->perf_fd >= 0) {
+		ioctl(own_profile->perf_fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+		close(own_profile->perf_fd);
+		own_profile->perf_fd = -1;
+	}
+	own_profile = NULL;
+}
+
+static inline void read_counters(uint64_t *values)
+{
+	uint64_t group[1 + NR_COUNTERS];
+
+	if (own_profile->perf_fd < 0 || read(own_profile->perf_fd, group, sizeof(group)) != sizeof(group)) {
+		memset(values, 0, NR_COUNTERS * sizeof(uint64_t));
+		return;
+	}
+	memcpy(values, group + 1, NR_COUNTERS * sizeof(uint64_t));
+}
+
+void profile_begin(int phase)
+{
+	thread_profile *profile = own_profile;
+	int depth;
+
+	if (profile == NULL)
+		return;
+	depth = profile->depth++;
+
+	profile->stack[depth] = phase;
+	read_counters(profile->start_counters[depth]);
+	profile->start_ns[depth] = monotonic_ns();
+}
+
+void profile_end(void)
+{
+	thread_profile *profile = own_profile;
+	phase_counters *phase;
+	uint64_t values[NR_COUNTERS];
+	int depth;
+
+	if (profile == NULL)
+		return;
+	depth = --profile->depth;
+	phase = &profile->phases[profile->stack[depth]];
+
+	phase->wall_ns += monotonic_ns() - profile->start_ns[depth];
+	read_counters(values);
+	for (int c = 0; c < NR_COUNTERS; c++)
+		phase->counters[c] += values[c] - profile->start_counters[depth][c];
+	phase->calls++;
+}
+
+static inline void profile_barrier(uint64_t ns)
+{
+	thread_profile *profile = own_profile;
+
+	if (profile != NULL && profile->depth > 0)
+		profile->phases[profile->stack[profile->depth - 1]].barrier_ns += ns;
+}
+
+// prints on stderr, for every phase, the mean and the maximum over the
+// threads of the wall time, the share of the barriers and the counters,
+// then dumps the records of every thread in PROFILE_CSV
+void profile_report(void)
+{
+	char name[32];
+	uint64_t total, max, barrier, counters[NR_COUNTERS];
+	phase_counters *phase;
+	FILE *fp;
+
+	fprintf(stderr, "%-12s %8s %12s %12s %9s %16s %16s %14s %6s\n", "phase", "calls",
+		"mean_ms", "max_ms", "barrier%", "cycles", "instructions", "llc_misses", "ipc");
+	for (int p = 0; p < NR_PHASES; p++) {
+		total = max = barrier = 0;
+		memset(counters, 0, sizeof(counters));
+		for (int t = 0; t < profile_threads; t++) {
+			phase = &profiles[t].phases[p];
+			total += phase->wall_ns;
+			max = phase->wall_ns > max ? phase->wall_ns : max;
+			barrier += phase->barrier_ns;
+			for (int c = 0; c < NR_COUNTERS; c++)
+				counters[c] += phase->counters[c];
+		}
+		if (profiles[0].phases[p].calls == 0 && total == 0)
+			continue;
+
+		phase_name(p, name, sizeof(name));
+		fprintf(stderr, "%-12s %8llu %12.3f %12.3f %9.1f %16llu %16llu %14llu %6.2f\n", name,
+			(unsigned long long) profiles[0].phases[p].calls,
+			total / 1e6 / profile_threads, max / 1e6,
+			total ? 100.0 * barrier / total : 0.0,
+			(unsigned long long) counters[0], (unsigned long long) counters[1],
+			(unsigned long long) counters[2],
+			counters[0] ? (double) counters[1] / counters[0] : 0.0);
+	}
+	if (profile_no_counters)
+		fprintf(stderr, "(perf_event_open nu este disponibil, contoarele sunt 0)\n");
+
+	fp = fopen(PROFILE_CSV, "w");
+	if (fp == NULL) {
+		fprintf(stderr, "Eroare la deschiderea fisierului %s\n", PROFILE_CSV);
+		profile_free();
+		return;
+	}
+	fprintf(fp, "thread,phase,calls,wall_ns,barrier_ns,cycles,instructions,llc_misses\n");
+	for (int t = 0; t < profile_threads; t++) {
+		for (int p = 0; p < NR_PHASES; p++) {
+			phase = &profiles[t].phases[p];
+			if (phase->calls == 0)
+				continue;
+			phase_name(p, name, sizeof(name));
+			fprintf(fp, "%d,%s,%llu,%llu,%llu,%llu,%llu,%llu\n", t, name,
+				(unsigned long long) phase->calls, (unsigned long long) phase->wall_ns,
+				(unsigned long long) phase->barrier_ns, (unsigned long long) phase->counters[0],
+				(unsigned long long) phase->counters[1], (unsigned long long) phase->counters[2]);
+		}
+	}
+	fclose(fp);
+
+	profile_free();
+}
+
+#define PROFILE_INIT(nr_threads, nr_generations) profile_start(nr_threads, nr_generations)
+#define PROFILE_THREAD_START(id) do { profile_thread_start(id); TRACE_THREAD_START(id); } while (0)
+#define PROFILE_THREAD_STOP() profile_thread_stop()
+#define PROFILE_BEGIN(phase) do { profile_begin(phase); TRACE_BEGIN(phase); } while (0)
+#define PROFILE_END() do { profile_end(); TRACE_END(); } while (0)
+#define PROFILE_REPORT() do { profile_report(); TRACE_REPORT(); } while (0)
+#define PROFILE_FREE() do { profile_free(); TRACE_FREE(); } while (0)
+
+#else
+
+#define PROFILE_INIT(nr_threads, nr_generations) TRACE_INIT(nr_threads, nr_generations)
+#define PROFILE_THREAD_START(id) TRACE_THREAD_START(id)
+#define PROFILE_THREAD_STOP()
+#define PROFILE_BEGIN(phase) TRACE_BEGIN(phase)
+#define PROFILE_END() TRACE_END()
+#define PROFILE_REPORT() TRACE_REPORT()
+#define PROFILE_FREE() TRACE_FREE()
+
+#endif
+
+#define PROFILE_GENERATION(k) TRACE_GENERATION(k)
+
+// the barrier of the algorithm, the waiting time being
+// added to the current phase when profiling and traced
+// as a phase of its own when tracing
+// (id being the number of the thread among those of the barrier)
+static inline void wait_barrier(thread_barrier *barrier, int id)
+{
+#ifdef PROFILE
+	uint64_t start = monotonic_ns();
+#endif
+
+	TRACE_BEGIN(PHASE_BARRIER);
+	barrier_wait(barrier, id);
+	TRACE_END();
+
+#ifdef PROFILE
+	profile_barrier(monotonic_ns() - start);
+#endif
+}
+
+#endif
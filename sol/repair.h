@@ -0,0 +1,134 @@
+#ifndef REPAIR_H
+#define REPAIR_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "fitness.h"
+#include "individual.h"
+#include "chromosome_pool.h"
+#include "ga.h"
+
+// the greedy operators, both driven by the objects sorted once by their
+// profit / weight ratio: the repair takes the objects with the lowest
+// ratios out of an individual that is too heavy for the sack, the
+// greedy seeding puts the objects with the highest ratios in the sack
+// of the first generation while they fit
+
+// how the first generation is built
+#define SEEDING_SINGLE GA_SEEDING_SINGLE
+#define SEEDING_GREEDY GA_SEEDING_GREEDY
+#define SEEDING_RANDOM GA_SEEDING_RANDOM
+
+typedef struct _ratio_entry {
+	int index;
+	int profit;
+	int weight;
+} ratio_entry;
+
+// ascending ratio (compared as products, so that the objects without
+// weight come last), then by index
+int compare_ratios(const void *a, const void *b)
+{
+	const ratio_entry *x = a, *y = b;
+	long long left = (long long) x->profit * y->weight;
+	long long right = (long long) y->profit * x->weight;
+
+	if (left != right)
+		return left < right ? -1 : 1;
+	return x->index - y->index;
+}
+
+// the objects in ascending order of their ratio, or NULL
+int *init_ratio_order(const object_table *table)
+{
+	int n = table->nr_objects;
+	ratio_entry *entries = malloc(n * sizeof(ratio_entry));
+	int *order = malloc(n * sizeof(int));
+
+	if (entries == NULL || order == NULL) {
+		free(entries);
+		free(order);
+		return NULL;
+	}
+
+	for (int i = 0; i < n; i++) {
+		entries[i].index = i;
+		entries[i].profit = table->profits[i];
+		entries[i].weight = table->weights[i];
+	}
+	qsort(entries, n, sizeof(ratio_entry), compare_ratios);
+	for (int i = 0; i < n; i++) {
+		order[i] = entries[i].index;
+	}
+
+	free(entries);
+	return order;
+}
+
+static inline void take_object(individual *ind, int j, const object_table *table, int sign)
+{
+	flip_gene(ind->chromosomes, j);
+	ind->weight += sign * table->weights[j];
+	ind->profit += sign * table->profits[j];
+	ind->count += sign;
+}
+
+// takes out of the sack the objects with the lowest ratios until the
+// individual fits, its chromosomes are copied first if they are shared
+void repair_individual(chromosome_pool *pool, individual *ind, const object_table *table,
+	const int *ratio_order, int capacity)
+{
+	if (ind->weight <= capacity)
+		return;
+
+	make_writable(pool, ind);
+	for (int r = 0; r < table->nr_objects && ind->weight > capacity; r++) {
+		if (get_gene(ind->chromosomes, ratio_order[r]))
+			take_object(ind, ratio_order[r], table, -1);
+	}
+}
+
+// the generator of the randomized seeding, one state per individual
+static inline uint64_t splitmix64(uint64_t *state)
+{
+	uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+// fills the sack of an individual (which may already hold its seed
+// object, the totals being up to date) with the objects of the highest
+// ratios that still fit; the randomized seeding skips every object
+// with a probability of 1/2, the generator depending only on the
+// random seed and on the number of the individual, so the population
+// is the same whatever the number of threads
+void greedy_seed_individual(individual *ind, int number, const object_table *table,
+	const int *ratio_order, int capacity, int seeding, uint64_t random_seed)
+{
+	uint64_t state = random_seed ^ ((uint64_t) number * 0xd1b54a32d192ed03ULL);
+	uint64_t bits = 0;
+	int nr_bits = 0, j;
+
+	for (int r = table->nr_objects - 1; r >= 0; r--) {
+		j = ratio_order[r];
+		if (get_gene(ind->chromosomes, j) || ind->weight + table->weights[j] > capacity)
+			continue;
+
+		if (seeding == SEEDING_RANDOM) {
+			if (nr_bits == 0) {
+				bits = splitmix64(&state);
+				nr_bits = 64;
+			}
+			nr_bits--;
+			if ((bits >> nr_bits) & 1)
+				continue;
+		}
+		take_object(ind, j, table, 1);
+	}
+}
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef SACK_OBJECT_H
+#define SACK_OBJECT_H
+
+// structure for the object to be put in the sack
+typedef struct _sack_object {
+    int weight;
+    int profit;
+} sack_object;
+
+#endif
@@ -0,0 +1,163 @@
+#ifndef SHARED_ISLANDS_H
+#define SHARED_ISLANDS_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "individual.h"
+
+// the segment of POSIX shared memory through which the worker processes
+// (each one running its own islands) exchange migrants
+// every worker has an outbox in which it posts copies of its best
+// individuals; the other workers read it without any lock, like a
+// seqlock: the sequence is odd while the worker writes the outbox and
+// a reader keeps the migrants only if the sequence is the same, and
+// even, before and after it copied them
+// the workers never wait for each other, a worker that is slow or
+// that died simply stops sending new migrants
+
+// a migrant in an outbox, followed by its chromosome words
+typedef struct _shared_migrant {
+	int weight;
+	int profit;
+	int count;
+	int generation;
+	uint64_t chromosomes[];
+} shared_migrant;
+
+// the state of a worker, on its own cache line
+typedef struct _worker_slot {
+	_Atomic uint64_t sequence;
+	_Atomic int nr_migrants;
+	_Atomic int best_fitness;
+	_Atomic int done;
+} __attribute__((aligned(64))) worker_slot;
+
+// the header of the segment, followed by the slots of the workers
+// and then by their outboxes
+typedef struct _shared_islands {
+	char name[64];
+	size_t size;
+	int nr_workers;
+	int nr_words;
+	int capacity;
+	size_t migrant_size;
+	size_t outbox_size;
+	worker_slot *slots;
+	char *outboxes;
+} shared_islands;
+
+static inline size_t shared_migrant_size(int nr_words)
+{
+	return (sizeof(shared_migrant) + nr_words * sizeof(uint64_t) + 63) / 64 * 64;
+}
+
+// creates the segment of the coordinator, before the workers are
+// forked (they inherit the mapping)
+int create_shared_islands(shared_islands *shared, int nr_workers, int nr_words, int capacity)
+{
+	size_t slots_size = nr_workers * sizeof(worker_slot);
+	int fd;
+
+	snprintf(shared->name, sizeof(shared->name), "/tema1_par.%d", (int) getpid());
+	shared->nr_workers = nr_workers;
+	shared->nr_words = nr_words;
+	shared->capacity = capacity;
+	shared->migrant_size = shared_migrant_size(nr_words);
+	shared->outbox_size = capacity * shared->migrant_size;
+	shared->size = slots_size + nr_workers * shared->outbox_size;
+
+	fd = shm_open(shared->name, O_CREAT | O_EXCL | O_RDWR, 0600);
+	if (fd < 0)
+		return 0;
+	if (ftruncate(fd, shared->size) < 0) {
+		close(fd);
+		shm_unlink(shared->name);
+		return 0;
+	}
+
+	shared->slots = mmap(NULL, shared->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (shared->slots == MAP_FAILED) {
+		shm_unlink(shared->name);
+		return 0;
+	}
+	shared->outboxes = (char *) shared->slots + slots_size;
+
+	// ftruncate fills the segment with zeros, so the sequences,
+	// the numbers of migrants and the flags start from 0
+	for (int w = 0; w < nr_workers; w++)
+		atomic_store(&shared->slots[w].best_fitness, -1);
+
+	return 1;
+}
+
+void destroy_shared_islands(shared_islands *shared)
+{
+	munmap(shared->slots, shared->size);
+	shm_unlink(shared->name);
+}
+
+static inline shared_migrant *outbox_migrant(const shared_islands *shared, int worker, int i)
+{
+	return (shared_migrant *) (shared->outboxes + worker * shared->outbox_size + i * shared->migrant_size);
+}
+
+// the worker replaces the migrants of its outbox with count individuals
+void post_migrants(shared_islands *shared, int worker, const individual *from, int count,
+	int generation)
+{
+	worker_slot *slot = &shared->slots[worker];
+	shared_migrant *migrant;
+
+	if (count > shared->capacity)
+		count = shared->capacity;
+
+	atomic_fetch_add(&slot->sequence, 1);
+	atomic_thread_fence(memory_order_release);
+	for (int i = 0; i < count; i++) {
+		migrant = outbox_migrant(shared, worker, i);
+		migrant->weight = from[i].weight;
+		migrant->profit = from[i].profit;
+		migrant->count = from[i].count;
+		migrant->generation = generation;
+		memcpy(migrant->chromosomes, from[i].chromosomes, shared->nr_words * sizeof(uint64_t));
+	}
+	atomic_store(&slot->nr_migrants, count);
+	atomic_fetch_add(&slot->sequence, 1);
+}
+
+// copies at most count migrants of a worker in buffer, returns how many
+// were copied; 0 if there are none or if the outbox was being written
+// or was already read (last_sequence is the sequence seen last time)
+int fetch_migrants(const shared_islands *shared, int worker, char *buffer, int count,
+	uint64_t *last_sequence)
+{
+	worker_slot *slot = &shared->slots[worker];
+	uint64_t before, after;
+	int available;
+
+	before = atomic_load(&slot->sequence);
+	if ((before & 1) || before == *last_sequence)
+		return 0;
+
+	available = atomic_load(&slot->nr_migrants);
+	if (count > available)
+		count = available;
+	memcpy(buffer, outbox_migrant(shared, worker, 0), count * shared->migrant_size);
+	atomic_thread_fence(memory_order_acquire);
+
+	after = atomic_load(&slot->sequence);
+	if (after != before)
+		return 0;
+
+	*last_sequence = before;
+	return count;
+}
+
+#endif
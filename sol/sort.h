@@ -0,0 +1,362 @@
+#ifndef SORT_H
+#define SORT_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <pthread.h>
+#include "individual.h"
+#include "profile.h"
+
+// an individual seen by the sort: its key and its position in
+// the generation; the key orders the individuals by fitness
+// (decreasing) and by count (increasing), the position breaks
+// the ties, just like merge_intervals does
+typedef struct _sort_entry {
+	uint64_t key;
+	int pos;
+} sort_entry;
+
+// the data shared by the threads that select the best individuals
+// of a generation (allocated once, for the whole run)
+typedef struct _selection_state {
+	sort_entry *entries;
+	sort_entry *entries_aux;
+	unsigned char *selected;
+	int *run_length;
+	int *rest_count;
+	sort_entry *local_last;
+	int *histogram;
+	// the rounding of the slices of the threads (see slice_bound)
+	int slice_align;
+} selection_state;
+
+// the radix sort takes 8 bits of the key in every pass
+#define RADIX_BITS 8
+#define RADIX_SIZE (1 << RADIX_BITS)
+#define RADIX_PASSES (64 / RADIX_BITS)
+
+static inline uint64_t individual_sort_key(const individual *ind)
+{
+	return ((uint64_t) (unsigned) (INT_MAX - ind->fitness) << 32) | (unsigned) ind->count;
+}
+
+static inline int entry_less(const sort_entry *a, const sort_entry *b)
+{
+	return a->key < b->key || (a->key == b->key && a->pos < b->pos);
+}
+
+int compare_entries(const void *a, const void *b)
+{
+	return entry_less(a, b) ? -1 : entry_less(b, a);
+}
+
+// the slice of thread id is [slice_bound(id), slice_bound(id + 1)),
+// the bounds being rounded to multiples of align (1 for the threads
+// that are not pinned); the fitness of a slice is computed by the
+// thread that reads its keys first in the sorts, so both take the
+// same slices
+static inline int slice_bound(int id, int length, int nr_threads, int align)
+{
+	int bound;
+
+	if (id >= nr_threads)
+		return length;
+	bound = id * (double) length / nr_threads;
+	if (align > 1)
+		bound = (bound + align / 2) / align * align;
+	return bound < length ? bound : length;
+}
+
+int init_selection_state(selection_state *state, int length, int nr_threads)
+{
+	state->entries = malloc(length * sizeof(sort_entry));
+	state->entries_aux = malloc(length * sizeof(sort_entry));
+	state->selected = malloc(length);
+	state->run_length = malloc(nr_threads * sizeof(int));
+	state->rest_count = malloc(nr_threads * sizeof(int));
+	state->local_last = malloc(nr_threads * sizeof(sort_entry));
+	state->histogram = malloc(nr_threads * RADIX_PASSES * RADIX_SIZE * sizeof(int));
+	state->slice_align = 1;
+
+	return state->entries && state->entries_aux && state->selected
+		&& state->run_length && state->rest_count && state->local_last
+		&& state->histogram;
+}
+
+void free_selection_state(selection_state *state)
+{
+	free(state->entries);
+	free(state->entries_aux);
+	free(state->selected);
+	free(state->run_length);
+	free(state->rest_count);
+	free(state->local_last);
+	free(state->histogram);
+}
+
+// moves the k smallest entries in the first k positions (quickselect)
+void select_entries(sort_entry *v, int n, int k)
+{
+	int left = 0, right = n - 1;
+	int i, j;
+	sort_entry pivot, tmp;
+
+	while (left < right) {
+		pivot = v[left + (right - left) / 2];
+		i = left;
+		j = right;
+		while (i <= j) {
+			while (entry_less(&v[i], &pivot))
+				i++;
+			while (entry_less(&pivot, &v[j]))
+				j--;
+			if (i <= j) {
+				tmp = v[i];
+				v[i] = v[j];
+				v[j] = tmp;
+				i++;
+				j--;
+			}
+		}
+
+		if (k - 1 <= j)
+			right = j;
+		else if (k - 1 >= i)
+			left = i;
+		else
+			break;
+	}
+}
+
+// returns how many of the first k entries of the merge of a and b
+// come from a (merge path search)
+int co_rank(int k, const sort_entry *a, int m, const sort_entry *b, int n)
+{
+	int low = k > n ? k - n : 0;
+	int high = k < m ? k : m;
+	int i;
+
+	while (low < high) {
+		i = low + (high - low) / 2;
+		// too few entries from a if a[i] is smaller than b[k - i - 1]
+		if (entry_less(&a[i], &b[k - i - 1]))
+			low = i + 1;
+		else
+			high = i;
+	}
+
+	return low;
+}
+
+// writes the entries of ranks [from, to) of the merge of a and b in out
+void merge_entries(const sort_entry *a, int m, const sort_entry *b, int n,
+	int from, int to, sort_entry *out)
+{
+	int i = co_rank(from, a, m, b, n);
+	int j = from - i;
+
+	for (int r = from; r < to; r++) {
+		if (j >= n || (i < m && entry_less(&a[i], &b[j])))
+			out[r] = a[i++];
+		else
+			out[r] = b[j++];
+	}
+}
+
+// parallel partial sort: after the call *v holds the first top individuals
+// in the same order as after a full sort, the worst individual on the last
+// position and all the others in between, in no particular order
+// every thread sorts (or only selects the best top of) its slice, then
+// the sorted runs are merged two by two, keeping only the first top
+// entries, each merge being split between the threads of the pair
+void select_top_parallel(individual **v, individual **v_prev, int length, int top,
+	selection_state *state, int thread_id, int P, thread_barrier *barrier)
+{
+	int start = slice_bound(thread_id, length, P, state->slice_align);
+	int end = slice_bound(thread_id + 1, length, P, state->slice_align);
+	int n = end - start;
+	sort_entry *entries = state->entries;
+	sort_entry *out = state->entries_aux;
+	sort_entry *last = NULL, *tmp;
+	individual *src = *v, *dst = *v_prev, *aux;
+	int offset, worst;
+
+	if (top > length)
+		top = length;
+
+	// keys of the slice, the worst entry of the slice is kept apart
+	for (int i = start; i < end; i++) {
+		entries[i].key = individual_sort_key(&src[i]);
+		entries[i].pos = i;
+		state->selected[i] = 0;
+		if (last == NULL || entry_less(last, &entries[i]))
+			last = &entries[i];
+	}
+	if (n > 0)
+		state->local_last[thread_id] = *last;
+
+	if (n > top) {
+		select_entries(entries + start, n, top);
+		n = top;
+	}
+	qsort(entries + start, n, sizeof(sort_entry), compare_entries);
+	state->run_length[thread_id] = n;
+	wait_barrier(barrier, thread_id);
+
+	// merge the runs two by two, the run of thread t is stored from
+	// the start of its slice; in a round the threads of a group of
+	// 2 * width share the merge of the runs of its first thread
+	// and of the thread width places after it
+	for (int width = 1; width < P; width *= 2) {
+		int group = thread_id / (2 * width) * (2 * width);
+		int group_size = (group + 2 * width < P ? 2 * width : P - group);
+		int first = slice_bound(group, length, P, state->slice_align);
+		int second = slice_bound(group + width, length, P, state->slice_align);
+		int m = state->run_length[group];
+		int k = group + width < P ? state->run_length[group + width] : 0;
+		int total = (m + k < top) ? m + k : top;
+		int rank = thread_id - group;
+
+		merge_entries(entries + first, m, entries + second, k,
+			rank * (double) total / group_size,
+			(rank + 1) * (double) total / group_size, out + first);
+		wait_barrier(barrier, thread_id);
+
+		if (rank == 0)
+			state->run_length[group] = total;
+		tmp = entries;
+		entries = out;
+		out = tmp;
+		wait_barrier(barrier, thread_id);
+	}
+
+	// the best individuals are moved first, in order
+	start = thread_id * (double) top / P;
+	end = (thread_id + 1) * (double) top / P;
+	for (int i = start; i < end; i++) {
+		dst[i] = src[entries[i].pos];
+		state->selected[entries[i].pos] = 1;
+	}
+
+	// the worst individual overall is the last of one of the slices
+	worst = -1;
+	for (int t = 0; t < P; t++) {
+		if (slice_bound(t, length, P, state->slice_align) < slice_bound(t + 1, length, P, state->slice_align)
+			&& (worst < 0 || entry_less(&state->local_last[worst], &state->local_last[t])))
+			worst = t;
+	}
+	worst = state->local_last[worst].pos;
+	wait_barrier(barrier, thread_id);
+
+	// the rest are moved after them, every thread counting
+	// first how many are left in its slice
+	start = slice_bound(thread_id, length, P, state->slice_align);
+	end = slice_bound(thread_id + 1, length, P, state->slice_align);
+	n = 0;
+	for (int i = start; i < end; i++) {
+		if (!state->selected[i] && i != worst)
+			n++;
+	}
+	state->rest_count[thread_id] = n;
+	wait_barrier(barrier, thread_id);
+
+	offset = top;
+	for (int t = 0; t < thread_id; t++)
+		offset += state->rest_count[t];
+	for (int i = start; i < end; i++) {
+		if (!state->selected[i] && i != worst)
+			dst[offset++] = src[i];
+	}
+	if (thread_id == 0 && !state->selected[worst])
+		dst[length - 1] = src[worst];
+	wait_barrier(barrier, thread_id);
+
+	// every thread switches its own pointers, like in mergesort_parallel
+	aux = *v;
+	*v = *v_prev;
+	*v_prev = aux;
+}
+
+// parallel LSD radix sort of the keys, followed by a single
+// permutation of the individuals
+// every pass is stable, so the individuals with equal keys keep
+// the order of their positions; each thread counts the digits of
+// its slice, then scatters the slice after the entries with smaller
+// digits and after the same digits of the threads before it
+// the digits of all the passes are counted once at the start and
+// the passes in which all the keys have the same digit are skipped
+void radix_sort_parallel(individual **v, individual **v_prev, int length,
+	selection_state *state, int thread_id, int P, thread_barrier *barrier)
+{
+	int start = slice_bound(thread_id, length, P, state->slice_align);
+	int end = slice_bound(thread_id + 1, length, P, state->slice_align);
+	sort_entry *entries = state->entries;
+	sort_entry *out = state->entries_aux;
+	sort_entry *tmp;
+	individual *src = *v, *dst = *v_prev, *aux;
+	int *histogram = state->histogram + thread_id * RADIX_PASSES * RADIX_SIZE;
+	int offset[RADIX_SIZE];
+	int digit, total, count, pass, skip[RADIX_PASSES];
+
+	memset(histogram, 0, RADIX_PASSES * RADIX_SIZE * sizeof(int));
+	for (int i = start; i < end; i++) {
+		entries[i].key = individual_sort_key(&src[i]);
+		entries[i].pos = i;
+		for (pass = 0; pass < RADIX_PASSES; pass++)
+			histogram[pass * RADIX_SIZE + ((entries[i].key >> (pass * RADIX_BITS)) & (RADIX_SIZE - 1))]++;
+	}
+	wait_barrier(barrier, thread_id);
+
+	// all the threads reach the same decision for every pass
+	for (pass = 0; pass < RADIX_PASSES; pass++) {
+		skip[pass] = 0;
+		for (digit = 0; digit < RADIX_SIZE && !skip[pass]; digit++) {
+			count = 0;
+			for (int t = 0; t < P; t++)
+				count += state->histogram[(t * RADIX_PASSES + pass) * RADIX_SIZE + digit];
+			skip[pass] = (count == length);
+		}
+	}
+	wait_barrier(barrier, thread_id);
+
+	for (pass = 0; pass < RADIX_PASSES; pass++) {
+		if (skip[pass])
+			continue;
+
+		// the slice of the thread changes after every pass,
+		// so its digits are counted again
+		memset(histogram, 0, RADIX_SIZE * sizeof(int));
+		for (int i = start; i < end; i++)
+			histogram[(entries[i].key >> (pass * RADIX_BITS)) & (RADIX_SIZE - 1)]++;
+		wait_barrier(barrier, thread_id);
+
+		total = 0;
+		for (digit = 0; digit < RADIX_SIZE; digit++) {
+			for (int t = 0; t < P; t++) {
+				if (t == thread_id)
+					offset[digit] = total;
+				total += state->histogram[t * RADIX_PASSES * RADIX_SIZE + digit];
+			}
+		}
+
+		for (int i = start; i < end; i++)
+			out[offset[(entries[i].key >> (pass * RADIX_BITS)) & (RADIX_SIZE - 1)]++] = entries[i];
+		tmp = entries;
+		entries = out;
+		out = tmp;
+		wait_barrier(barrier, thread_id);
+	}
+
+	for (int i = start; i < end; i++)
+		dst[i] = src[entries[i].pos];
+	wait_barrier(barrier, thread_id);
+
+	aux = *v;
+	*v = *v_prev;
+	*v_prev = aux;
+}
+
+#endif
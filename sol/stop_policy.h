@@ -0,0 +1,79 @@
+#ifndef STOP_POLICY_H
+#define STOP_POLICY_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "clock.h"
+
+// when the generations stop before the number given on the command
+// line: after stagnation generations without a better best fitness,
+// once the best fitness reaches target or once the time limit (in
+// seconds) is over; 0 (-1 for the target) turns a criterion off
+typedef struct _stop_policy {
+	int stagnation;
+	int target;
+	double time_limit;
+} stop_policy;
+
+// the state of the policy, checked by a single thread; with one island
+// stop is set before the barrier at the end of the reproduction and read
+// after it, with islands it is set between the two barriers of the
+// migration and read after the second one, so all the threads leave the
+// loop after the same generation (stop is atomic only so that the read
+// is not torn or hoisted out of the loop, the barriers order it)
+typedef struct _stop_state {
+	stop_policy policy;
+	int best_fitness;
+	int last_improvement;
+	// when the run started (or would have started, for a resumed run)
+	uint64_t start_ns;
+	uint64_t deadline_ns;
+	// the generation after which the loop is left, or -1
+	int stopped_at;
+	_Atomic int stop;
+} stop_state;
+
+static inline int stop_policy_enabled(const stop_policy *policy)
+{
+	return policy->stagnation > 0 || policy->target >= 0 || policy->time_limit > 0;
+}
+
+void init_stop_state(stop_state *state, const stop_policy *policy, int first_generation)
+{
+	state->policy = *policy;
+	state->best_fitness = -1;
+	state->last_improvement = first_generation;
+	state->start_ns = monotonic_ns();
+	state->deadline_ns = policy->time_limit > 0 ? state->start_ns + (uint64_t) (policy->time_limit * 1e9) : 0;
+	state->stopped_at = -1;
+	atomic_init(&state->stop, 0);
+}
+
+// the state of a resumed run, elapsed_ns being the time the run took
+// up to its checkpoint
+void resume_stop_state(stop_state *state, int best_fitness, int last_improvement, uint64_t elapsed_ns)
+{
+	state->best_fitness = best_fitness;
+	state->last_improvement = last_improvement;
+	state->start_ns = monotonic_ns() - elapsed_ns;
+	if (state->deadline_ns)
+		state->deadline_ns = state->start_ns + (uint64_t) (state->policy.time_limit * 1e9);
+}
+
+// called with the best fitness of generation k
+void check_stop_policy(stop_state *state, int best_fitness, int k)
+{
+	if (best_fitness > state->best_fitness) {
+		state->best_fitness = best_fitness;
+		state->last_improvement = k;
+	}
+
+	if ((state->policy.stagnation > 0 && k - state->last_improvement >= state->policy.stagnation)
+		|| (state->policy.target >= 0 && state->best_fitness >= state->policy.target)
+		|| (state->deadline_ns && monotonic_ns() >= state->deadline_ns)) {
+		state->stopped_at = k;
+		atomic_store_explicit(&state->stop, 1, memory_order_relaxed);
+	}
+}
+
+#endif
@@ -2,12 +2,11 @@
 
 int main(int argc, char* argv[]) {
 	
-	// declare the array of objects
-	sack_object *objects = NULL;
+	// declare the table of objects
+	object_table table;
 
-	// declare the number of objects and the capacity of the sack
+	// declare the capacity of the sack
 	int capacity = 0;
-	int nr_objects = 0;
 	// declare the number of threads to use
 	int nr_threads;
 	// declare the number of generations
@@ -15,20 +14,46 @@ int main(int argc, char* argv[]) {
 	
 	// read input from the file
 	int err;
-	err = read_input(&objects, &nr_objects, &capacity,
+	err = read_input(&table, &capacity,
 						&nr_gen, &nr_threads, argc, argv);
 	if (err == 0) {
 		return 0;
 	}
 
-	// print_objects(objects, nr_objects);
-	// printf("%d %d %d %d\n", nr_objects, capacity, nr_gen, nr_threads);
+	// read the optional settings
+	ga_options opts;
+	if (!read_options(&opts, argc, argv)) {
+		free_object_table(&table);
+		return 0;
+	}
+
+	// print_objects(&table);
+	// printf("%d %d %d %d\n", table.nr_objects, capacity, nr_gen, nr_threads);
 
 	// run the genetic algorithm
-	run_genetic_algorithm(objects, nr_objects, nr_gen, capacity, nr_threads);
+	ga_result result;
+	int isa = select_kernels(opts.isa);
+	if (opts.print_isa)
+		fprintf(stderr, "set de instructiuni: %s (cel mai bun suportat: %s)\n",
+			isa_name(isa), isa_name(detect_isa()));
+	print_progress_header(stdout, opts.log_format);
+	if (opts.nr_processes > 1)
+		err = run_workers(&table, nr_gen, capacity, nr_threads, &opts, &result);
+	else
+		err = run_genetic_algorithm(&table, nr_gen, capacity, nr_threads, &opts, &result);
+
+	// print the final result (the best fitness)
+	if (err) {
+		print_final_fitness(&result, nr_gen, opts.log_format);
+		if (stop_policy_enabled(&opts.stop) && result.genes != NULL)
+			print_best_individual(&result);
+		ga_free_result(&result);
+	} else {
+		print_run_error(&result, &opts);
+	}
 
 	// free the memory
-	free(objects);
+	free_object_table(&table);
 
-	return 0;
+	return err ? 0 : -1;
 }
\ No newline at end of file
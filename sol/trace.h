@@ -0,0 +1,202 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "phases.h"
+#include "clock.h"
+
+// timeline of the phases, compiled only with -DTRACE (make build_trace)
+// every thread appends a begin and an end event for every phase (and
+// for every wait at a barrier) to a buffer of its own, so the threads
+// never synchronize while recording; after the threads are joined the
+// buffers are written as a Chrome trace (chrome://tracing, Perfetto)
+// the buffers are sized from the number of generations, up to
+// MAX_TRACE_EVENTS events; when a buffer is full the new phases are
+// dropped, but the end of every phase whose begin was recorded still
+// fits, so the timeline stays well nested
+
+#ifdef TRACE
+
+// the events reserved for every generation of every thread
+#define TRACE_EVENTS_PER_GENERATION 256
+#define MAX_TRACE_DEPTH 16
+// the events of a thread, whatever the number of generations
+#define MAX_TRACE_EVENTS (1 << 24)
+
+// the file in which the timeline is written
+#define TRACE_JSON "trace.json"
+
+#define TRACE_EVENT_BEGIN 0
+#define TRACE_EVENT_END 1
+
+typedef struct _trace_event {
+	uint64_t ns;
+	int generation;
+	short phase;
+	short type;
+} trace_event;
+
+// the buffer of a thread, on its own cache lines
+typedef struct _thread_trace {
+	trace_event *events;
+	int nr_events;
+	int capacity;
+	int dropped;
+	int depth;
+	int generation;
+	// whether the begin of the phases open at every depth was recorded
+	char recorded[MAX_TRACE_DEPTH];
+} __attribute__((aligned(64))) thread_trace;
+
+thread_trace *traces;
+int trace_threads;
+uint64_t trace_start_ns;
+__thread thread_trace *own_trace;
+
+void trace_free(void)
+{
+	if (traces == NULL)
+		return;
+	for (int t = 0; t < trace_threads; t++)
+		free(traces[t].events);
+	free(traces);
+	traces = NULL;
+}
+
+// returns 0 if the buffers could not be allocated
+int trace_init(int nr_threads, int nr_generations)
+{
+	size_t capacity = ((size_t) nr_generations + 2) * TRACE_EVENTS_PER_GENERATION;
+
+	// the rest of the phases of a long run are dropped
+	if (nr_generations < 0 || capacity > MAX_TRACE_EVENTS)
+		capacity = MAX_TRACE_EVENTS;
+
+	traces = aligned_alloc(64, nr_threads * sizeof(thread_trace));
+	if (traces == NULL)
+		return 0;
+	memset(traces, 0, nr_threads * sizeof(thread_trace));
+
+	for (trace_threads = 0; trace_threads < nr_threads; trace_threads++) {
+		traces[trace_threads].capacity = capacity;
+		traces[trace_threads].events = malloc(capacity * sizeof(trace_event));
+		if (traces[trace_threads].events == NULL) {
+			trace_free();
+			return 0;
+		}
+	}
+	trace_start_ns = monotonic_ns();
+	return 1;
+}
+
+void trace_thread_start(int id)
+{
+	own_trace = &traces[id];
+}
+
+static inline void trace_begin(int phase)
+{
+	thread_trace *trace = own_trace;
+	trace_event *event;
+
+	if (trace == NULL || trace->depth >= MAX_TRACE_DEPTH)
+		return;
+
+	// room is kept for the ends of all the open phases
+	trace->recorded[trace->depth] = (trace->nr_events < trace->capacity - MAX_TRACE_DEPTH);
+	if (trace->recorded[trace->depth]) {
+		event = &trace->events[trace->nr_events++];
+		event->ns = monotonic_ns();
+		event->generation = trace->generation;
+		event->phase = phase;
+		event->type = TRACE_EVENT_BEGIN;
+	} else {
+		trace->dropped++;
+	}
+	trace->depth++;
+}
+
+static inline void trace_end(void)
+{
+	thread_trace *trace = own_trace;
+	trace_event *event;
+
+	if (trace == NULL || trace->depth == 0)
+		return;
+
+	trace->depth--;
+	if (trace->recorded[trace->depth]) {
+		event = &trace->events[trace->nr_events++];
+		event->ns = monotonic_ns();
+		event->generation = trace->generation;
+		event->phase = 0;
+		event->type = TRACE_EVENT_END;
+	}
+}
+
+// writes the events of all the threads, each thread being
+// a track of its own, then frees the buffers
+void trace_report(void)
+{
+	char name[32];
+	trace_event *event;
+	FILE *fp;
+	int first = 1, dropped = 0;
+
+	fp = fopen(TRACE_JSON, "w");
+	if (fp == NULL) {
+		fprintf(stderr, "Eroare la deschiderea fisierului %s\n", TRACE_JSON);
+	} else {
+		fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+		for (int t = 0; t < trace_threads; t++) {
+			fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+				"\"args\":{\"name\":\"thread %d\"}}", first ? "" : ",\n", t, t);
+			first = 0;
+			for (int e = 0; e < traces[t].nr_events; e++) {
+				event = &traces[t].events[e];
+				if (event->type == TRACE_EVENT_BEGIN) {
+					phase_name(event->phase, name, sizeof(name));
+					fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"B\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,"
+						"\"args\":{\"generation\":%d}}", name, t,
+						(event->ns - trace_start_ns) / 1e3, event->generation);
+				} else {
+					fprintf(fp, ",\n{\"ph\":\"E\",\"pid\":1,\"tid\":%d,\"ts\":%.3f}", t,
+						(event->ns - trace_start_ns) / 1e3);
+				}
+			}
+			dropped += traces[t].dropped;
+		}
+		fprintf(fp, "\n]}\n");
+		fclose(fp);
+	}
+
+	if (dropped)
+		fprintf(stderr, "%d evenimente nu au incaput in bufferele de trasare\n", dropped);
+
+	trace_free();
+}
+
+#define TRACE_INIT(nr_threads, nr_generations) trace_init(nr_threads, nr_generations)
+#define TRACE_THREAD_START(id) trace_thread_start(id)
+#define TRACE_GENERATION(k) (own_trace->generation = (k))
+#define TRACE_BEGIN(phase) trace_begin(phase)
+#define TRACE_END() trace_end()
+#define TRACE_REPORT() trace_report()
+#define TRACE_FREE() trace_free()
+
+#else
+
+#define TRACE_INIT(nr_threads, nr_generations) 1
+#define TRACE_THREAD_START(id)
+#define TRACE_GENERATION(k)
+#define TRACE_BEGIN(phase)
+#define TRACE_END()
+#define TRACE_REPORT()
+#define TRACE_FREE()
+
+#endif
+
+#endif
@@ -0,0 +1,121 @@
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+// every phase of a generation is split in chunks of consecutive
+// tasks, every thread gets a deque with an equal share of them;
+// a thread runs the chunks from the back of its own deque and, when
+// it is left without work, steals chunks from the front of the others
+#define CHUNKS_PER_THREAD 8
+
+// the deque of a thread is a range [low, high) of chunks, packed
+// together with the phase it belongs to in a single word, so that the
+// owner and the thieves both take chunks with one compare and swap
+// and a thief never takes a chunk of another phase
+#define DEQUE_BITS 24
+#define DEQUE_MASK ((1ULL << DEQUE_BITS) - 1)
+
+typedef struct _work_deque {
+	_Atomic uint64_t range;
+	int phase;
+} __attribute__((aligned(64))) work_deque;
+
+// the pool shared by all the threads of the algorithm
+typedef struct _work_pool {
+	work_deque *deques;
+	int nr_threads;
+} work_pool;
+
+// the function that runs the tasks from [start, end) of a phase
+typedef void (*work_fn)(void *arg, int start, int end);
+
+int init_work_pool(work_pool *pool, int nr_threads)
+{
+	pool->nr_threads = nr_threads;
+	pool->deques = aligned_alloc(64, nr_threads * sizeof(work_deque));
+	if (pool->deques == NULL)
+		return 0;
+
+	for (int i = 0; i < nr_threads; i++) {
+		atomic_init(&pool->deques[i].range, 0);
+		pool->deques[i].phase = 0;
+	}
+
+	return 1;
+}
+
+void free_work_pool(work_pool *pool)
+{
+	free(pool->deques);
+	pool->deques = NULL;
+}
+
+static inline uint64_t pack_range(uint64_t phase, uint64_t low, uint64_t high)
+{
+	return (phase << (2 * DEQUE_BITS)) | (low << DEQUE_BITS) | high;
+}
+
+// takes a chunk from the back (owner) or from the front (thief) of
+// a deque of the given phase, returns -1 if the deque is empty
+int take_chunk(work_deque *deque, uint64_t phase, int from_front)
+{
+	uint64_t range = atomic_load(&deque->range);
+	uint64_t low, high;
+
+	while (1) {
+		low = (range >> DEQUE_BITS) & DEQUE_MASK;
+		high = range & DEQUE_MASK;
+		if ((range >> (2 * DEQUE_BITS)) != phase || low >= high)
+			return -1;
+
+		if (from_front) {
+			if (atomic_compare_exchange_weak(&deque->range, &range, pack_range(phase, low + 1, high)))
+				return low;
+		} else {
+			if (atomic_compare_exchange_weak(&deque->range, &range, pack_range(phase, low, high - 1)))
+				return high - 1;
+		}
+	}
+}
+
+// runs the tasks [0, n) of a phase, all the threads call it with the
+// same arguments; when it returns, all the chunks have been taken, but
+// some may still be running on other threads, so the caller has to
+// wait at a barrier before using the results
+void parallel_for(work_pool *pool, int id, int n, work_fn body, void *arg)
+{
+	int P = pool->nr_threads;
+	work_deque *own = &pool->deques[id];
+	int grain, nr_chunks, chunk, victim;
+	uint64_t phase;
+
+	if (n <= 0)
+		return;
+
+	grain = (n + P * CHUNKS_PER_THREAD - 1) / (P * CHUNKS_PER_THREAD);
+	nr_chunks = (n + grain - 1) / grain;
+
+	// the phases are numbered in the same way by all the threads
+	own->phase++;
+	phase = own->phase & ((1 << (64 - 2 * DEQUE_BITS)) - 1);
+	atomic_store(&own->range, pack_range(phase, id * (double) nr_chunks / P,
+		(id + 1) * (double) nr_chunks / P));
+
+	while ((chunk = take_chunk(own, phase, 0)) >= 0) {
+		body(arg, chunk * grain, (chunk + 1) * grain < n ? (chunk + 1) * grain : n);
+	}
+
+	// steal from the others, starting with the next thread
+	for (int i = 1; i < P; i++) {
+		victim = (id + i) % P;
+		while ((chunk = take_chunk(&pool->deques[victim], phase, 1)) >= 0) {
+			body(arg, chunk * grain, (chunk + 1) * grain < n ? (chunk + 1) * grain : n);
+		}
+	}
+}
+
+#endif